@@ -1,3 +0,0 @@
-C:\VulkanSDK\1.4.304.1\Bin\glslc.exe C:\Users\Cristian\Desktop\Vulkan-Project\data\shaders\shader.vert -c -o vert.spv
-C:\VulkanSDK\1.4.304.1\Bin\glslc.exe C:\Users\Cristian\Desktop\Vulkan-Project\data\shaders\shader.frag -c -o frag.spv
-pause
\ No newline at end of file
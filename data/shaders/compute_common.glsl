@@ -0,0 +1,17 @@
+// Shared declarations for the batch compute kernels (reduce, prefix sum and convolution)
+
+layout(std430, set = 0, binding = 0) readonly buffer Input   { uint values[]; };
+layout(std430, set = 0, binding = 1)          buffer Output  { uint result[]; };
+layout(std430, set = 0, binding = 2)          buffer Scratch { uint scratch[]; };    // Prefix sum: [0] = carry, then the block sums
+
+// Matches ComputeParams in ComputeBatch.cpp
+layout(push_constant) uniform Params
+{
+    uint count;         // Elements in the tile
+    uint pass;          // Prefix sum pass
+    uint width;         // Convolution image
+    uint height;
+    uint inputY0;       // Image row of the first row in the input buffer
+    uint bandY0;        // Image row of the first output row
+    uint bandRows;
+} pc;
@@ -0,0 +1,19 @@
+#version 450
+
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec4 inNormal;
+
+layout(location = 0) out vec3 fragColor;
+
+layout(push_constant) uniform PushConstants
+{
+    mat4 viewProj;
+    vec4 cameraPos;
+    uint meshletCount;
+} pc;
+
+// Classic vertex input path, used as the reference for the meshlet paths
+void main() {
+    gl_Position = pc.viewProj * vec4(inPosition.xyz, 1.0);
+    fragColor   = inNormal.xyz * 0.5 + 0.5;
+}
@@ -0,0 +1,18 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+#include "meshlet_common.glsl"
+
+layout(location = 0) out vec3 fragColor;
+
+// Vertex pulling for the compute culling fallback: one indirect draw per meshlet
+void main() {
+    Meshlet m = meshlets[gl_InstanceIndex];
+
+    uint packed = meshletTriangles[m.triangleOffset + gl_VertexIndex / 3];
+    uint local  = (packed >> (8 * (gl_VertexIndex % 3))) & 0xFF;
+    Vertex v    = vertices[meshletVertices[m.vertexOffset + local]];
+
+    gl_Position = pc.viewProj * vec4(v.position.xyz, 1.0);
+    fragColor   = v.normal.xyz * 0.5 + 0.5;
+}
@@ -0,0 +1,56 @@
+// Shared declarations for the meshlet shaders (task, mesh, cull compute and vertex pulling)
+
+struct Vertex
+{
+    vec4 position;
+    vec4 normal;
+};
+
+struct Meshlet
+{
+    uint vertexOffset;
+    uint triangleOffset;
+    uint vertexCount;
+    uint triangleCount;
+};
+
+struct MeshletBounds
+{
+    vec4 sphere;    // xyz = center, w = radius
+    vec4 cone;      // xyz = axis, w = cutoff
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Vertices         { Vertex vertices[]; };
+layout(std430, set = 0, binding = 1) readonly buffer Meshlets         { Meshlet meshlets[]; };
+layout(std430, set = 0, binding = 2) readonly buffer Bounds           { MeshletBounds bounds[]; };
+layout(std430, set = 0, binding = 3) readonly buffer MeshletVertices  { uint meshletVertices[]; };
+layout(std430, set = 0, binding = 4) readonly buffer MeshletTriangles { uint meshletTriangles[]; };
+
+layout(push_constant) uniform PushConstants
+{
+    mat4 viewProj;
+    vec4 cameraPos;
+    uint meshletCount;
+} pc;
+
+bool isMeshletVisible(uint idx)
+{
+    vec4 sphere = bounds[idx].sphere;
+    vec4 cone   = bounds[idx].cone;
+
+    // Normal cone: the whole meshlet faces away from the camera
+    vec3 view = sphere.xyz - pc.cameraPos.xyz;
+    if (dot(view, cone.xyz) >= cone.w * length(view) + sphere.w)
+        return false;
+
+    // Frustum: planes extracted from the rows of viewProj (depth is [0, 1])
+    mat4 m = transpose(pc.viewProj);
+    vec4 planes[5] = vec4[](m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[2]);
+    for (int i = 0; i < 5; i++)
+    {
+        if (dot(planes[i].xyz, sphere.xyz) + planes[i].w < -sphere.w * length(planes[i].xyz))
+            return false;
+    }
+
+    return true;
+}
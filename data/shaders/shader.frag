@@ -1,9 +1,37 @@
 #version 450
 
+// Features of the pipeline variant (see ShaderVariants.h). They're specialization constants,
+// the driver compiles the disabled ones out, so nothing below branches at runtime
+layout(constant_id = 0) const bool LIGHTING = false;    // fragColor is an encoded normal, light it
+layout(constant_id = 1) const bool DITHER   = false;    // Ordered dithering of the 8 bit output
+
 layout(location = 0) in vec3 fragColor;
 
 layout(location = 0) out vec4 outColor;
 
+const vec3 LIGHT_DIR = vec3(0.37, 0.74, 0.56);
+
+// 4x4 Bayer matrix, normalized to [-0.5, 0.5)
+const float BAYER[16] = float[](
+     0.0,  8.0,  2.0, 10.0,
+    12.0,  4.0, 14.0,  6.0,
+     3.0, 11.0,  1.0,  9.0,
+    15.0,  7.0, 13.0,  5.0);
+
 void main() {
-    outColor = vec4(fragColor, 1.0);
-}
\ No newline at end of file
+    vec3 color = fragColor;
+
+    if (LIGHTING)
+    {
+        vec3 normal = normalize(fragColor * 2.0 - 1.0);
+        color = vec3(0.15 + 0.85 * max(dot(normal, LIGHT_DIR), 0.0));
+    }
+
+    if (DITHER)
+    {
+        uvec2 pixel = uvec2(gl_FragCoord.xy) & 3u;
+        color += (BAYER[pixel.y * 4u + pixel.x] / 16.0 - 0.5) / 255.0;
+    }
+
+    outColor = vec4(color, 1.0);
+}
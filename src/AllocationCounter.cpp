@@ -0,0 +1,68 @@
+#include "AllocationCounter.h"
+
+#include <cstdlib>
+#include <new>
+
+// Per thread so the render farm workers don't disturb each other's measures
+static thread_local uint64_t allocations = 0;
+
+uint64_t AllocationCounter::count()
+{
+    return allocations;
+}
+
+#pragma region GLOBAL NEW/DELETE
+
+// The nothrow and array forms forward to these by default
+
+void* operator new(std::size_t size)
+{
+    allocations++;
+    if (void* ptr = std::malloc(size ? size : 1))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    allocations++;
+    size_t align = static_cast<size_t>(alignment);
+    size         = ((size ? size : 1) + align - 1) & ~(align - 1);
+
+#ifdef _WIN32
+    void* ptr = _aligned_malloc(size, align);
+#else
+    void* ptr = std::aligned_alloc(align, size);
+#endif
+    if (ptr)
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t alignment) noexcept
+{
+    operator delete(ptr, alignment);
+}
+
+#pragma endregion
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstdint>
+
+// Counts the heap allocations made through operator new on the calling thread.
+// Used to check that the steady state frame loop doesn't allocate
+namespace AllocationCounter
+{
+    uint64_t count();
+}
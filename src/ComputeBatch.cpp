@@ -0,0 +1,510 @@
+#include "ComputeBatch.h"
+#include "ResourceTracker.h"
+
+#include <chrono>
+#include <cstring>
+
+// Width of the convolution test image, the height follows from the size of the run
+static constexpr uint32_t CONVOLVE_WIDTH = 4096;
+static constexpr uint32_t CONVOLVE_HALO  = 2;       // Rows above and below a band read by the 5x5 kernel
+static constexpr uint32_t SCAN_BLOCK     = 1024;    // Values scanned by a workgroup, see "compute_scan.comp"
+
+#pragma region CPU REFERENCE
+// Plain loops the compiler vectorizes, the baseline the GPU has to beat
+
+static uint32_t cpuReduce(const std::vector<uint32_t>& values)
+{
+    // Independent accumulators so the adds don't serialize
+    uint32_t acc[8]{};
+    size_t i = 0;
+    for (; i + 8 <= values.size(); i += 8)
+    {
+        for (size_t k = 0; k < 8; k++)
+            acc[k] += values[i + k];
+    }
+    for (; i < values.size(); i++)
+        acc[0] += values[i];
+
+    uint32_t sum = 0;
+    for (uint32_t a : acc)
+        sum += a;
+
+    return sum;
+}
+
+static void cpuPrefixSum(const std::vector<uint32_t>& values, std::vector<uint32_t>& out)
+{
+    uint32_t total = 0;
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        total += values[i];
+        out[i] = total;
+    }
+}
+
+static void cpuConvolve(const std::vector<uint32_t>& image, uint32_t width, uint32_t height, std::vector<uint32_t>& out)
+{
+    const uint32_t kernel[5] = { 1, 4, 6, 4, 1 };
+
+    // Separable: the vertical pass is kept in full precision, so the result is the one of the 2D kernel
+    std::vector<uint32_t> column(static_cast<size_t>(width) * 4);
+    for (uint32_t y = 0; y < height; y++)
+    {
+        std::fill(column.begin(), column.end(), 0u);
+        for (int dy = -2; dy <= 2; dy++)
+        {
+            uint32_t sy = static_cast<uint32_t>(std::clamp(static_cast<int>(y) + dy, 0, static_cast<int>(height) - 1));
+            const uint8_t* row = reinterpret_cast<const uint8_t*>(&image[static_cast<size_t>(sy) * width]);
+            uint32_t weight = kernel[dy + 2];
+            for (size_t i = 0; i < column.size(); i++)
+                column[i] += row[i] * weight;
+        }
+
+        for (uint32_t x = 0; x < width; x++)
+        {
+            uint32_t acc[4]{};
+            for (int dx = -2; dx <= 2; dx++)
+            {
+                uint32_t sx = static_cast<uint32_t>(std::clamp(static_cast<int>(x) + dx, 0, static_cast<int>(width) - 1));
+                for (uint32_t c = 0; c < 4; c++)
+                    acc[c] += column[sx * 4 + c] * kernel[dx + 2];
+            }
+
+            uint32_t pixel = 0;
+            for (uint32_t c = 0; c < 4; c++)
+                pixel |= ((acc[c] + 128) >> 8) << (8 * c);
+            out[static_cast<size_t>(y) * width + x] = pixel;
+        }
+    }
+}
+#pragma endregion
+
+ComputeBatch::ComputeBatch(VKSetUp& setUp_, VkDeviceSize tileBytes_)
+    : setUp(setUp_), device(setUp_.getDevice())
+{
+    try
+    {
+        // Whole scan blocks and whole image rows per tile
+        tileBytes = std::max<VkDeviceSize>(tileBytes_ / (CONVOLVE_WIDTH * 4) * (CONVOLVE_WIDTH * 4), CONVOLVE_WIDTH * 4);
+
+        // Input, output and prefix sum scratch
+        const uint32_t bindingCount = 3;
+        VkDescriptorSetLayoutBinding bindings[bindingCount]{};
+        for (uint32_t i = 0; i < bindingCount; i++)
+        {
+            bindings[i].binding         = i;
+            bindings[i].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            bindings[i].descriptorCount = 1;
+            bindings[i].stageFlags      = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+
+        VkDescriptorSetLayoutCreateInfo setLayoutInfo{};
+        setLayoutInfo.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        setLayoutInfo.bindingCount  = bindingCount;
+        setLayoutInfo.pBindings     = bindings;
+
+        if (vkCreateDescriptorSetLayout(device, &setLayoutInfo, ResourceTracker::allocator(), &setLayout) != VK_SUCCESS)
+            throw std::runtime_error("failed to create the compute descriptor set layout");
+        ResourceTracker::created(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT, setLayout);
+
+        VkDescriptorPoolSize poolSize{};
+        poolSize.type               = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        poolSize.descriptorCount    = bindingCount * 2;
+
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType          = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.maxSets        = 2;
+        poolInfo.poolSizeCount  = 1;
+        poolInfo.pPoolSizes     = &poolSize;
+
+        if (vkCreateDescriptorPool(device, &poolInfo, ResourceTracker::allocator(), &pool) != VK_SUCCESS)
+            throw std::runtime_error("failed to create the compute descriptor pool");
+        ResourceTracker::created(VK_OBJECT_TYPE_DESCRIPTOR_POOL, pool);
+
+        VkPushConstantRange pushRange{};
+        pushRange.stageFlags    = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushRange.size          = sizeof(ComputeParams);
+
+        VkPipelineLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType                    = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        layoutInfo.setLayoutCount           = 1;
+        layoutInfo.pSetLayouts              = &setLayout;
+        layoutInfo.pushConstantRangeCount   = 1;
+        layoutInfo.pPushConstantRanges      = &pushRange;
+
+        if (vkCreatePipelineLayout(device, &layoutInfo, ResourceTracker::allocator(), &layout) != VK_SUCCESS)
+            throw std::runtime_error("failed to create the compute pipeline layout");
+        ResourceTracker::created(VK_OBJECT_TYPE_PIPELINE_LAYOUT, layout);
+
+        const char* shaders[] = {
+            SHADER_DIR "compute_reduce.spv",
+            SHADER_DIR "compute_scan.spv",
+            SHADER_DIR "compute_convolve.spv" };
+        for (size_t i = 0; i < static_cast<size_t>(ComputeKernel::Count); i++)
+        {
+            VkShaderModule module = setUp.loadShaderModule(shaders[i]);
+
+            VkComputePipelineCreateInfo computeInfo{};
+            computeInfo.sType           = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+            computeInfo.stage.sType     = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            computeInfo.stage.stage     = VK_SHADER_STAGE_COMPUTE_BIT;
+            computeInfo.stage.module    = module;
+            computeInfo.stage.pName     = "main";
+            computeInfo.layout          = layout;
+
+            VkResult result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &computeInfo, ResourceTracker::allocator(), &pipelines[i]);
+            ResourceTracker::created(VK_OBJECT_TYPE_PIPELINE, pipelines[i]);
+            ResourceTracker::destroyed(VK_OBJECT_TYPE_SHADER_MODULE, module);
+            vkDestroyShaderModule(device, module, ResourceTracker::allocator());
+            if (result != VK_SUCCESS)
+                throw std::runtime_error("could not create the compute pipeline");
+        }
+
+        // Tile buffers of the two slots. The input has room for the halo rows of the convolution
+        VkDeviceSize inBytes  = tileBytes + 2 * CONVOLVE_HALO * CONVOLVE_WIDTH * 4;
+        VkDeviceSize outBytes = tileBytes;
+        VkMemoryPropertyFlags hostMemory = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+        scratch = setUp.createBuffer((1 + tileBytes / 4 / SCAN_BLOCK + 1) * sizeof(uint32_t),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        VkCommandBuffer cmds[2];
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool        = setUp.getCommandPool();
+        allocInfo.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 2;
+
+        if (vkAllocateCommandBuffers(device, &allocInfo, cmds) != VK_SUCCESS)
+            throw std::runtime_error("failed to allocate the compute command buffers");
+        slots[0].cmd = cmds[0];
+        slots[1].cmd = cmds[1];
+
+        VkDescriptorSetLayout setLayouts[2] = { setLayout, setLayout };
+        VkDescriptorSet sets[2];
+        VkDescriptorSetAllocateInfo setAllocInfo{};
+        setAllocInfo.sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        setAllocInfo.descriptorPool     = pool;
+        setAllocInfo.descriptorSetCount = 2;
+        setAllocInfo.pSetLayouts        = setLayouts;
+
+        if (vkAllocateDescriptorSets(device, &setAllocInfo, sets) != VK_SUCCESS)
+            throw std::runtime_error("failed to allocate the compute descriptor sets");
+        slots[0].set = sets[0];
+        slots[1].set = sets[1];
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+        for (size_t i = 0; i < 2; i++)
+        {
+            Slot& slot = slots[i];
+            slot.stagingIn  = setUp.createBuffer(inBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, hostMemory);
+            slot.deviceIn   = setUp.createBuffer(inBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            slot.deviceOut  = setUp.createBuffer(outBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            slot.stagingOut = setUp.createBuffer(outBytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT, hostMemory);
+            if (vkMapMemory(device, slot.stagingIn.memory, 0, inBytes, 0, &slot.mappedIn) != VK_SUCCESS ||
+                vkMapMemory(device, slot.stagingOut.memory, 0, outBytes, 0, &slot.mappedOut) != VK_SUCCESS)
+                throw std::runtime_error("failed to map the compute staging buffers");
+
+            if (vkCreateFence(device, &fenceInfo, ResourceTracker::allocator(), &slot.fence) != VK_SUCCESS)
+                throw std::runtime_error("failed to create the compute fence");
+            ResourceTracker::created(VK_OBJECT_TYPE_FENCE, slot.fence);
+
+            const GpuBuffer* buffers[bindingCount] = { &slot.deviceIn, &slot.deviceOut, &scratch };
+            VkDescriptorBufferInfo bufferInfos[bindingCount]{};
+            VkWriteDescriptorSet   writes[bindingCount]{};
+            for (uint32_t b = 0; b < bindingCount; b++)
+            {
+                bufferInfos[b].buffer   = buffers[b]->buffer;
+                bufferInfos[b].range    = VK_WHOLE_SIZE;
+
+                writes[b].sType             = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                writes[b].dstSet            = slot.set;
+                writes[b].dstBinding        = b;
+                writes[b].descriptorCount   = 1;
+                writes[b].descriptorType    = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                writes[b].pBufferInfo       = &bufferInfos[b];
+            }
+            vkUpdateDescriptorSets(device, bindingCount, writes, 0, nullptr);
+        }
+    }
+    catch (...)
+    {
+        // The destructor doesn't run for a half built object, whatever was created so far goes here
+        release();
+        throw;
+    }
+}
+
+ComputeBatch::~ComputeBatch()
+{
+    release();
+}
+
+void ComputeBatch::release()
+{
+    // Null handles are skipped by the destroys, it runs on a partly created batch too
+    vkDeviceWaitIdle(device);
+
+    for (auto& slot : slots)
+    {
+        for (GpuBuffer* buffer : { &slot.stagingIn, &slot.deviceIn, &slot.deviceOut, &slot.stagingOut })
+            setUp.destroyBuffer(*buffer);
+        ResourceTracker::destroyed(VK_OBJECT_TYPE_FENCE, slot.fence);
+        vkDestroyFence(device, slot.fence, ResourceTracker::allocator());
+        vkFreeCommandBuffers(device, setUp.getCommandPool(), 1, &slot.cmd);
+    }
+    setUp.destroyBuffer(scratch);
+
+    for (auto pipeline : pipelines)
+    {
+        ResourceTracker::destroyed(VK_OBJECT_TYPE_PIPELINE, pipeline);
+        vkDestroyPipeline(device, pipeline, ResourceTracker::allocator());
+    }
+    ResourceTracker::destroyed(VK_OBJECT_TYPE_PIPELINE_LAYOUT, layout);
+    vkDestroyPipelineLayout(device, layout, ResourceTracker::allocator());
+    ResourceTracker::destroyed(VK_OBJECT_TYPE_DESCRIPTOR_POOL, pool);
+    vkDestroyDescriptorPool(device, pool, ResourceTracker::allocator());
+    ResourceTracker::destroyed(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT, setLayout);
+    vkDestroyDescriptorSetLayout(device, setLayout, ResourceTracker::allocator());
+}
+
+const char* ComputeBatch::kernelName(ComputeKernel kernel)
+{
+    switch (kernel)
+    {
+    case ComputeKernel::Reduce:     return "reduce";
+    case ComputeKernel::PrefixSum:  return "prefix sum";
+    case ComputeKernel::Convolve:   return "convolution 5x5";
+    default:                        return "unknown";
+    }
+}
+
+static void memoryBarrier(VkCommandBuffer cmd,
+    VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess,
+    VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess)
+{
+    VkMemoryBarrier2 barrier{};
+    barrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+    barrier.srcStageMask    = srcStage;
+    barrier.srcAccessMask   = srcAccess;
+    barrier.dstStageMask    = dstStage;
+    barrier.dstAccessMask   = dstAccess;
+
+    VkDependencyInfo depInfo{};
+    depInfo.sType               = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    depInfo.memoryBarrierCount  = 1;
+    depInfo.pMemoryBarriers     = &barrier;
+
+    vkCmdPipelineBarrier2(cmd, &depInfo);
+}
+
+void ComputeBatch::recordTile(Slot& slot, ComputeKernel kernel, const ComputeParams& params,
+    VkDeviceSize inBytes, VkDeviceSize outBytes, bool firstTile)
+{
+    VkCommandBuffer cmd = slot.cmd;
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(cmd, &beginInfo);
+
+    // Only the dispatches are ordered with the previous tile (the scan carry is shared),
+    // the upload below is free to run while the other slot is still computing
+    memoryBarrier(cmd,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+
+    VkBufferCopy upload{};
+    upload.size = inBytes;
+    vkCmdCopyBuffer(cmd, slot.stagingIn.buffer, slot.deviceIn.buffer, 1, &upload);
+
+    if (kernel == ComputeKernel::Reduce)
+        vkCmdFillBuffer(cmd, slot.deviceOut.buffer, 0, sizeof(uint32_t), 0);
+    if (kernel == ComputeKernel::PrefixSum && firstTile)
+        vkCmdFillBuffer(cmd, scratch.buffer, 0, sizeof(uint32_t), 0);
+
+    memoryBarrier(cmd,
+        VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines[static_cast<size_t>(kernel)]);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, 1, &slot.set, 0, nullptr);
+
+    switch (kernel)
+    {
+    case ComputeKernel::Reduce:
+    {
+        // Fixed grid, the invocations stride over the tile
+        vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+        vkCmdDispatch(cmd, std::min(256u, (params.count + 255) / 256), 1, 1);
+        break;
+    }
+    case ComputeKernel::PrefixSum:
+    {
+        uint32_t blocks = (params.count + SCAN_BLOCK - 1) / SCAN_BLOCK;
+        uint32_t groups[3] = { blocks, 1, blocks };
+
+        ComputeParams passParams = params;
+        for (uint32_t pass = 0; pass < 3; pass++)
+        {
+            if (pass > 0)
+            {
+                memoryBarrier(cmd,
+                    VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                    VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+            }
+
+            passParams.pass = pass;
+            vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(passParams), &passParams);
+            vkCmdDispatch(cmd, groups[pass], 1, 1);
+        }
+        break;
+    }
+    case ComputeKernel::Convolve:
+        vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+        vkCmdDispatch(cmd, (params.width + 15) / 16, (params.bandRows + 15) / 16, 1);
+        break;
+    default:
+        break;
+    }
+
+    memoryBarrier(cmd,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT);
+
+    VkBufferCopy download{};
+    download.size = outBytes;
+    vkCmdCopyBuffer(cmd, slot.deviceOut.buffer, slot.stagingOut.buffer, 1, &download);
+
+    // Visible to the host once the fence is signaled
+    memoryBarrier(cmd,
+        VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_HOST_BIT, VK_ACCESS_2_HOST_READ_BIT);
+
+    vkEndCommandBuffer(cmd);
+}
+
+ComputeRunResult ComputeBatch::run(ComputeKernel kernel, VkDeviceSize totalBytes)
+{
+    ComputeRunResult result;
+
+    // Generated input, whole image rows for the convolution
+    size_t count = static_cast<size_t>(totalBytes / 4);
+    uint32_t height = 0;
+    if (kernel == ComputeKernel::Convolve)
+    {
+        height = std::max<uint32_t>(static_cast<uint32_t>(count / CONVOLVE_WIDTH), 1);
+        count  = static_cast<size_t>(height) * CONVOLVE_WIDTH;
+    }
+    result.bytes = count * sizeof(uint32_t);
+
+    std::vector<uint32_t> input(count);
+    uint32_t state = 0x12345678u;
+    for (auto& value : input)
+    {
+        // xorshift32
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        value  = state;
+    }
+
+    // CPU reference
+    std::vector<uint32_t> expected(kernel == ComputeKernel::Reduce ? 1 : count);
+    auto cpuStart = std::chrono::high_resolution_clock::now();
+    switch (kernel)
+    {
+    case ComputeKernel::Reduce:     expected[0] = cpuReduce(input); break;
+    case ComputeKernel::PrefixSum:  cpuPrefixSum(input, expected); break;
+    case ComputeKernel::Convolve:   cpuConvolve(input, CONVOLVE_WIDTH, height, expected); break;
+    default: break;
+    }
+    auto cpuEnd = std::chrono::high_resolution_clock::now();
+    result.cpuMs = std::chrono::duration<double, std::milli>(cpuEnd - cpuStart).count();
+
+    // GPU, tile by tile
+    std::vector<uint32_t> output(expected.size(), 0u);
+    size_t tileElements = static_cast<size_t>(tileBytes / 4);
+    size_t tileRows     = tileElements / CONVOLVE_WIDTH;
+    size_t tileCount    = kernel == ComputeKernel::Convolve
+        ? (height + tileRows - 1) / tileRows
+        : (count + tileElements - 1) / tileElements;
+    result.tiles = static_cast<unsigned>(tileCount);
+
+    VkQueue queue = setUp.getQueue();
+    SubmitScheduler& scheduler = setUp.getSubmitScheduler();
+
+    auto finish = [&](Slot& slot)
+    {
+        if (!slot.busy)
+            return;
+
+        if (vkWaitForFences(device, 1, &slot.fence, VK_TRUE, UINT64_MAX) != VK_SUCCESS)
+            throw std::runtime_error("Could not wait for the compute fence");
+        vkResetFences(device, 1, &slot.fence);
+
+        const uint32_t* data = static_cast<const uint32_t*>(slot.mappedOut);
+        if (kernel == ComputeKernel::Reduce)
+            output[0] += data[0];
+        else
+            memcpy(output.data() + slot.outOffset, data, slot.outCount * sizeof(uint32_t));
+
+        slot.busy = false;
+    };
+
+    auto gpuStart = std::chrono::high_resolution_clock::now();
+    for (size_t t = 0; t < tileCount; t++)
+    {
+        // The slot was last used two tiles ago, collect its result before reusing it
+        Slot& slot = slots[t % 2];
+        finish(slot);
+
+        ComputeParams params;
+        size_t inFirst, inCount;
+        if (kernel == ComputeKernel::Convolve)
+        {
+            uint32_t bandY0   = static_cast<uint32_t>(t * tileRows);
+            uint32_t bandRows = static_cast<uint32_t>(std::min<size_t>(tileRows, height - bandY0));
+            uint32_t inputY0  = bandY0 >= CONVOLVE_HALO ? bandY0 - CONVOLVE_HALO : 0;
+            uint32_t inputY1  = std::min(bandY0 + bandRows + CONVOLVE_HALO, height);
+
+            params.width    = CONVOLVE_WIDTH;
+            params.height   = height;
+            params.inputY0  = inputY0;
+            params.bandY0   = bandY0;
+            params.bandRows = bandRows;
+            params.count    = bandRows * CONVOLVE_WIDTH;
+
+            inFirst         = static_cast<size_t>(inputY0) * CONVOLVE_WIDTH;
+            inCount         = static_cast<size_t>(inputY1 - inputY0) * CONVOLVE_WIDTH;
+            slot.outOffset  = static_cast<size_t>(bandY0) * CONVOLVE_WIDTH;
+            slot.outCount   = params.count;
+        }
+        else
+        {
+            inFirst         = t * tileElements;
+            inCount         = std::min(tileElements, count - inFirst);
+            params.count    = static_cast<uint32_t>(inCount);
+            slot.outOffset  = inFirst;
+            slot.outCount   = kernel == ComputeKernel::Reduce ? 1 : inCount;
+        }
+
+        memcpy(slot.mappedIn, input.data() + inFirst, inCount * sizeof(uint32_t));
+        recordTile(slot, kernel, params, inCount * sizeof(uint32_t), slot.outCount * sizeof(uint32_t), t == 0);
+
+        scheduler.submit(queue, SubmitProducer::Compute, &slot.cmd, 1);
+        scheduler.setFence(queue, slot.fence);
+        scheduler.flush();
+        slot.busy = true;
+    }
+    for (auto& slot : slots)
+        finish(slot);
+    auto gpuEnd = std::chrono::high_resolution_clock::now();
+    result.gpuMs = std::chrono::duration<double, std::milli>(gpuEnd - gpuStart).count();
+
+    result.match = output == expected;
+
+    return result;
+}
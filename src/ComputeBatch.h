@@ -0,0 +1,89 @@
+#pragma once
+
+#include "VulkanSetUp.h"
+
+// Sample kernels of the compute batch mode, "data/shaders/compute_*.comp"
+enum class ComputeKernel
+{
+    Reduce,     // Sum of uint32 values
+    PrefixSum,  // Inclusive scan of uint32 values
+    Convolve,   // 5x5 Gaussian blur of an RGBA8 image
+    Count
+};
+
+struct ComputeRunResult
+{
+    VkDeviceSize    bytes   = 0;    // Input processed
+    unsigned        tiles   = 0;
+    double          gpuMs   = 0.0;  // Uploads, dispatches and downloads of every tile
+    double          cpuMs   = 0.0;  // Reference implementation on the CPU
+    bool            match   = false;
+};
+
+// Runs compute kernels over buffers larger than what is kept on the GPU at once. The input is cut
+// in tiles and two slots alternate: while the GPU works on one tile, the CPU fills the staging
+// buffer of the next and reads back the previous one, and the upload of a tile can overlap the
+// dispatches of the other. Works on a VKSetUp without views (no surface nor swap chain)
+class ComputeBatch
+{
+public:
+    ComputeBatch(VKSetUp& setUp, VkDeviceSize tileBytes);
+    ~ComputeBatch();
+
+    ComputeBatch(const ComputeBatch&)            = delete;
+    ComputeBatch& operator=(const ComputeBatch&) = delete;
+
+    // Processes totalBytes of generated data with the kernel, on the GPU then on the CPU, and compares them
+    ComputeRunResult run(ComputeKernel kernel, VkDeviceSize totalBytes);
+
+    static const char* kernelName(ComputeKernel kernel);
+
+private:
+    struct Slot
+    {
+        GpuBuffer       stagingIn;      // Host visible, persistently mapped
+        GpuBuffer       deviceIn;
+        GpuBuffer       deviceOut;
+        GpuBuffer       stagingOut;     // Host visible, persistently mapped
+        void*           mappedIn    = nullptr;
+        void*           mappedOut   = nullptr;
+        VkCommandBuffer cmd         = nullptr;
+        VkFence         fence       = nullptr;
+        VkDescriptorSet set         = nullptr;
+
+        // Tile in flight
+        bool            busy        = false;
+        size_t          outOffset   = 0;    // First output element of the tile
+        size_t          outCount    = 0;
+    };
+
+    // Matches the push constants of "compute_common.glsl"
+    struct ComputeParams
+    {
+        uint32_t count      = 0;
+        uint32_t pass       = 0;
+        uint32_t width      = 0;
+        uint32_t height     = 0;
+        uint32_t inputY0    = 0;
+        uint32_t bandY0     = 0;
+        uint32_t bandRows   = 0;
+    };
+
+    // Everything the constructor created, for the destructor and a constructor that throws midway
+    void release();
+
+    void recordTile(Slot& slot, ComputeKernel kernel, const ComputeParams& params,
+        VkDeviceSize inBytes, VkDeviceSize outBytes, bool firstTile);
+
+    VKSetUp&        setUp;
+    VkDevice        device;
+    VkDeviceSize    tileBytes;
+
+    Slot        slots[2];
+    GpuBuffer   scratch;    // Prefix sum carry and block sums, shared by the slots
+
+    VkDescriptorSetLayout   setLayout   = nullptr;
+    VkDescriptorPool        pool        = nullptr;
+    VkPipelineLayout        layout      = nullptr;
+    VkPipeline              pipelines[static_cast<size_t>(ComputeKernel::Count)]{};
+};
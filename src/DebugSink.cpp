@@ -0,0 +1,204 @@
+#include "DebugSink.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+static const char* severityName(VkDebugUtilsMessageSeverityFlagBitsEXT severity)
+{
+    switch (severity)
+    {
+    case VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT:   return "verbose";
+    case VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT:      return "info";
+    case VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT:   return "warning";
+    case VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT:     return "error";
+    default:                                                return "unknown";
+    }
+}
+
+static const char* typeName(VkDebugUtilsMessageTypeFlagsEXT type)
+{
+    if (type & VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT)
+        return "performance";
+    if (type & VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT)
+        return "validation";
+    return "general";
+}
+
+// FNV-1a, only for messages that come without an ID
+static uint64_t hashText(const char* text)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (; text && *text; text++)
+        hash = (hash ^ static_cast<uint8_t>(*text)) * 0x100000001b3ull;
+    return hash;
+}
+
+DebugSink::~DebugSink()
+{
+    stop();
+}
+
+void DebugSink::start()
+{
+    if (thread.joinable())
+        return;
+
+    stopping = false;
+    thread   = std::thread(&DebugSink::printLoop, this);
+}
+
+void DebugSink::stop()
+{
+    if (!thread.joinable())
+        return;
+
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    cv.notify_one();
+    thread.join();
+}
+
+void DebugSink::setFilter(const DebugFilter& filter)
+{
+    severityMask.store(filter.severities, std::memory_order_relaxed);
+    typeMask.store(filter.types, std::memory_order_relaxed);
+}
+
+DebugFilter DebugSink::getFilter() const
+{
+    DebugFilter filter;
+    filter.severities   = severityMask.load(std::memory_order_relaxed);
+    filter.types        = typeMask.load(std::memory_order_relaxed);
+    return filter;
+}
+
+VKAPI_ATTR VkBool32 VKAPI_CALL DebugSink::callback(
+    VkDebugUtilsMessageSeverityFlagBitsEXT severity,
+    VkDebugUtilsMessageTypeFlagsEXT type,
+    const VkDebugUtilsMessengerCallbackDataEXT* data,
+    void* userData)
+{
+    static_cast<DebugSink*>(userData)->receive(severity, type, data);
+    return VK_FALSE;
+}
+
+void DebugSink::receive(VkDebugUtilsMessageSeverityFlagBitsEXT severity, VkDebugUtilsMessageTypeFlagsEXT type,
+    const VkDebugUtilsMessengerCallbackDataEXT* data)
+{
+    if (!(severity & severityMask.load(std::memory_order_relaxed)) || !(type & typeMask.load(std::memory_order_relaxed)))
+        return;
+
+    Trace::instant("validation message", "debug", severity);
+
+    // The message ID is the same for every occurrence of a VUID/best practice check, the text isn't
+    // (handles, values...). Messages without an ID fall back on their text
+    uint64_t key = static_cast<uint32_t>(data->messageIdNumber);
+    key ^= (data->pMessageIdName ? hashText(data->pMessageIdName) : hashText(data->pMessage)) << 1;
+    key ^= static_cast<uint64_t>(severity) << 56;
+
+    std::lock_guard lock(mutex);
+
+    counts.messages++;
+    counts.errors       += severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT ? 1 : 0;
+    counts.warnings     += severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT ? 1 : 0;
+    counts.performance  += type & VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT ? 1 : 0;
+
+    auto it = entries.find(key);
+    if (it != entries.end())
+    {
+        it->second.count++;
+        return;
+    }
+
+    Entry entry;
+    entry.severity  = severity;
+    entry.type      = type;
+    entry.idName    = data->pMessageIdName ? data->pMessageIdName : "";
+    entry.message   = data->pMessage ? data->pMessage : "";
+    entry.count     = 1;
+    entries.emplace(key, std::move(entry));
+    counts.unique++;
+
+    pending.push_back(key);
+    cv.notify_one();
+}
+
+void DebugSink::printLoop()
+{
+    std::vector<uint64_t> batch;
+    std::string           text;
+
+    std::unique_lock lock(mutex);
+    while (true)
+    {
+        cv.wait(lock, [&]() { return stopping || !pending.empty(); });
+        if (pending.empty() && stopping)
+            break;
+
+        // Format under the lock (entries may rehash), write without it
+        batch.swap(pending);
+        text.clear();
+        for (uint64_t key : batch)
+        {
+            const Entry& entry = entries.at(key);
+            text += "validation layer (";
+            text += severityName(entry.severity);
+            text += ", ";
+            text += typeName(entry.type);
+            text += "): ";
+            text += entry.message;
+            text += '\n';
+        }
+        batch.clear();
+
+        lock.unlock();
+        std::cerr << text << std::flush;
+        lock.lock();
+    }
+}
+
+DebugSink::Counts DebugSink::getCounts() const
+{
+    std::lock_guard lock(mutex);
+    return counts;
+}
+
+void DebugSink::printReport(std::ostream& out, size_t topCount) const
+{
+    std::lock_guard lock(mutex);
+
+    out << "debug messages: " << counts.messages << " received (" << counts.unique << " unique), "
+        << counts.errors << " errors, " << counts.warnings << " warnings, " << counts.performance << " performance" << std::endl;
+
+    std::vector<const Entry*> sorted;
+    for (const auto& [key, entry] : entries)
+        sorted.push_back(&entry);
+    std::sort(sorted.begin(), sorted.end(), [](const Entry* a, const Entry* b) { return a->count > b->count; });
+
+    auto label = [](const Entry& entry) { return entry.idName.empty() ? entry.message.substr(0, 80) : entry.idName; };
+
+    size_t repeated = 0;
+    for (const Entry* entry : sorted)
+    {
+        if (entry->count < 2 || repeated == topCount)
+            break;
+        if (repeated++ == 0)
+            out << "  most repeated:" << std::endl;
+        out << "    " << entry->count << "x " << severityName(entry->severity) << " " << label(*entry) << std::endl;
+    }
+
+    bool header = false;
+    for (const Entry* entry : sorted)
+    {
+        if (!(entry->type & VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT))
+            continue;
+        if (!header)
+            out << "  performance warnings:" << std::endl;
+        header = true;
+        out << "    " << entry->count << "x " << label(*entry) << std::endl;
+    }
+}
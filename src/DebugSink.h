@@ -0,0 +1,91 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Which debug messages the messenger asks the layers for
+struct DebugFilter
+{
+    VkDebugUtilsMessageSeverityFlagsEXT severities = VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT |
+                                                     VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+    VkDebugUtilsMessageTypeFlagsEXT     types      = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT |
+                                                     VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
+                                                     VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+};
+
+// Receives the debug messenger callbacks. A message is only formatted and printed the first time
+// it's seen (by message ID), on a thread of the sink, repeats just bump a counter. So a layer that
+// complains every frame costs a map lookup, not a blocking write to the console.
+// Performance warnings are kept apart for the end of run report
+class DebugSink
+{
+public:
+    DebugSink() = default;
+    ~DebugSink();
+
+    DebugSink(const DebugSink&)            = delete;
+    DebugSink& operator=(const DebugSink&) = delete;
+
+    // Starts the printing thread. Messages received before are printed once it runs
+    void start();
+    // Prints whatever is pending and joins the thread
+    void stop();
+
+    // Messages outside of the filter are dropped by the callback
+    void                setFilter(const DebugFilter& filter);
+    DebugFilter         getFilter() const;
+
+    static VKAPI_ATTR VkBool32 VKAPI_CALL callback(
+        VkDebugUtilsMessageSeverityFlagBitsEXT severity,
+        VkDebugUtilsMessageTypeFlagsEXT type,
+        const VkDebugUtilsMessengerCallbackDataEXT* data,
+        void* userData);
+
+    struct Counts
+    {
+        uint64_t messages    = 0;   // Received and kept by the filter, repeats included
+        uint64_t unique      = 0;
+        uint64_t errors      = 0;
+        uint64_t warnings    = 0;
+        uint64_t performance = 0;
+    };
+    Counts getCounts() const;
+
+    // Totals, most repeated messages and every performance warning with its count
+    void printReport(std::ostream& out, size_t topCount = 10) const;
+
+private:
+    struct Entry
+    {
+        VkDebugUtilsMessageSeverityFlagBitsEXT  severity;
+        VkDebugUtilsMessageTypeFlagsEXT         type;
+        std::string                             idName;
+        std::string                             message;    // Text of the first occurrence
+        uint64_t                                count = 0;
+    };
+
+    void receive(VkDebugUtilsMessageSeverityFlagBitsEXT severity, VkDebugUtilsMessageTypeFlagsEXT type,
+        const VkDebugUtilsMessengerCallbackDataEXT* data);
+    void printLoop();
+
+    std::atomic<VkDebugUtilsMessageSeverityFlagsEXT>    severityMask{ DebugFilter{}.severities };
+    std::atomic<VkDebugUtilsMessageTypeFlagsEXT>        typeMask{ DebugFilter{}.types };
+
+    mutable std::mutex                      mutex;
+    std::condition_variable                 cv;
+    std::unordered_map<uint64_t, Entry>     entries;
+    std::vector<uint64_t>                   pending;    // Keys of the entries to print
+    Counts                                  counts;
+    std::thread                             thread;
+    bool                                    stopping = false;
+};
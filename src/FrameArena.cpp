@@ -0,0 +1,25 @@
+#include "FrameArena.h"
+
+#include <stdexcept>
+
+FrameArena::FrameArena(size_t capacity_)
+    : memory(new uint8_t[capacity_]), capacity(capacity_)
+{
+}
+
+void* FrameArena::allocateBytes(size_t size, size_t alignment)
+{
+    // Align the address, not the offset, the base is only aligned for the fundamental types
+    uintptr_t base    = reinterpret_cast<uintptr_t>(memory.get());
+    uintptr_t aligned = (base + offset + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+    size_t    end     = static_cast<size_t>(aligned - base) + size;
+
+    // Growing would mean a heap allocation in the frame, the capacity has to be raised instead
+    if (end > capacity)
+        throw std::runtime_error("frame arena exhausted, raise its capacity");
+
+    offset      = end;
+    highWater   = end > highWater ? end : highWater;
+
+    return reinterpret_cast<void*>(aligned);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+// Linear allocator for the transient CPU side structs of a frame (submit infos, barrier arrays,
+// pNext chains...). The memory is reserved once, allocating is a pointer bump and everything is
+// released at once with reset() or when a Scope ends, so the hot path never touches the heap
+class FrameArena
+{
+public:
+    explicit FrameArena(size_t capacity = 64 * 1024);
+
+    FrameArena(const FrameArena&)            = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // Value initialized array of count T. Only trivially destructible types, nothing is destroyed
+    template <typename T>
+    T* allocate(size_t count = 1)
+    {
+        static_assert(std::is_trivially_destructible_v<T>, "the arena never runs destructors");
+
+        T* data = static_cast<T*>(allocateBytes(sizeof(T) * count, alignof(T)));
+        for (size_t i = 0; i < count; i++)
+            new (data + i) T{};
+
+        return data;
+    }
+
+    void* allocateBytes(size_t size, size_t alignment);
+
+    // Releases everything allocated since the beginning of the frame
+    void reset() { offset = 0; }
+
+    // Releases everything allocated during the lifetime of the scope
+    class Scope
+    {
+    public:
+        explicit Scope(FrameArena& arena_) : arena(arena_), mark(arena_.offset) {}
+        ~Scope() { arena.offset = mark; }
+
+        Scope(const Scope&)            = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        FrameArena& arena;
+        size_t      mark;
+    };
+
+    size_t getCapacity() const  { return capacity; }
+    size_t getUsed() const      { return offset; }
+    size_t getHighWater() const { return highWater; }
+
+private:
+    std::unique_ptr<uint8_t[]> memory;
+    size_t capacity;
+    size_t offset    = 0;
+    size_t highWater = 0;
+};
@@ -0,0 +1,112 @@
+#include "FrameCapture.h"
+
+#include <stdexcept>
+
+uint64_t hashBytes(const void* data, size_t size)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+#pragma region RECORDER
+
+template <typename T>
+static void writeRaw(std::ofstream& file, const T& value)
+{
+    file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void FrameRecorder::open(const std::string& path, const CaptureHeader& header,
+    const std::vector<CaptureView>& views, const std::vector<CaptureUpload>& uploads)
+{
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        throw std::runtime_error("failed to open " + path);
+
+    writeRaw(file, header);
+    for (const auto& view : views)
+        writeRaw(file, view);
+    for (const auto& upload : uploads)
+        writeRaw(file, upload);
+
+    // A frame is usually a few hundred bytes
+    commands.reserve(16 * 1024);
+    frameCount = 0;
+}
+
+void FrameRecorder::close()
+{
+    if (file.is_open())
+        file.close();
+}
+
+void FrameRecorder::beginFrame(uint64_t frameIndex_)
+{
+    frameIndex = frameIndex_;
+    commands.clear();
+}
+
+void FrameRecorder::endFrame(float cpuMs)
+{
+    CaptureFrame frame{};
+    frame.frameIndex    = frameIndex;
+    frame.cpuMs         = cpuMs;
+    frame.commandBytes  = static_cast<uint32_t>(commands.size());
+
+    writeRaw(file, frame);
+    file.write(reinterpret_cast<const char*>(commands.data()), static_cast<std::streamsize>(commands.size()));
+    frameCount++;
+}
+
+#pragma endregion
+
+#pragma region CAPTURE
+
+template <typename T>
+static void readRaw(std::ifstream& file, T& value)
+{
+    if (!file.read(reinterpret_cast<char*>(&value), sizeof(T)))
+        throw std::runtime_error("truncated frame capture");
+}
+
+FrameCapture::FrameCapture(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+        throw std::runtime_error("failed to open " + path);
+
+    readRaw(file, header);
+    if (header.magic != CAPTURE_MAGIC)
+        throw std::runtime_error(path + " is not a frame capture");
+    if (header.version != CAPTURE_VERSION)
+        throw std::runtime_error(path + ": unsupported capture version " + std::to_string(header.version));
+
+    views.resize(header.viewCount);
+    for (auto& view : views)
+        readRaw(file, view);
+    uploads.resize(header.uploadCount);
+    for (auto& upload : uploads)
+        readRaw(file, upload);
+
+    // Frames until the end of the file
+    CaptureFrame frame;
+    while (file.read(reinterpret_cast<char*>(&frame), sizeof(frame)))
+    {
+        CapturedFrame& captured = frames.emplace_back();
+        captured.frameIndex = frame.frameIndex;
+        captured.cpuMs      = frame.cpuMs;
+        captured.commands.resize(frame.commandBytes);
+        if (!file.read(reinterpret_cast<char*>(captured.commands.data()), frame.commandBytes))
+            throw std::runtime_error("truncated frame capture");
+    }
+}
+
+#pragma endregion
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Binary log of the engine level commands of every frame (pipeline binds, draws, dispatches,
+// barriers, blits...) recorded by VKSetUp while a capture is active, and replayed headless by
+// VKSetUp::replayFrame. Handles aren't stored, only what they are in the engine (the meshlet
+// pipeline, the target of view 1...), so a capture replays on any device that has the features.
+//
+// File layout: CaptureHeader, CaptureView * viewCount, CaptureUpload * uploadCount, then per frame
+// a CaptureFrame followed by its commands: one FrameOp byte and the op's fixed size payload
+
+constexpr uint32_t CAPTURE_MAGIC   = 0x52464B56;   // "VKFR"
+constexpr uint32_t CAPTURE_VERSION = 4;
+
+enum class FrameOp : uint8_t
+{
+    BeginView,          // CmdBeginView
+    EndView,            // No payload
+    ImageBarrier,       // CmdImageBarrier
+    MemoryBarrier,      // CmdMemoryBarrier
+    BeginRendering,     // CmdBeginRendering
+    EndRendering,       // No payload
+    BindPipeline,       // CmdBindPipeline
+    BindMeshletSet,     // CmdBindPipeline (bind point of the set)
+    BindMeshBuffers,    // No payload
+    PushConstants,      // MeshPushConstants
+    Draw,               // CmdDraw
+    DrawIndexed,        // CmdDraw
+    DrawIndirect,       // CmdDraw
+    DrawMeshTasks,      // CmdDraw (x groups)
+    Dispatch,           // CmdDraw (x groups)
+    ResetTimestamps,    // CmdTimestamp
+    WriteTimestamp,     // CmdTimestamp
+    Blit,               // CmdBlit
+    CopyToReadback,     // CmdBeginView (view)
+};
+
+// What an image/pipeline is in the engine, resolved to handles when the command is issued
+enum class CaptureImage : uint8_t
+{
+    ViewTarget,     // Swap chain image or offscreen target of the view
+    ViewInternal,   // Dynamic resolution target of the view
+    ViewDepth,      // Depth target of the view
+    ViewMsaa,       // Multisampled color target of the view, resolved into ViewTarget/ViewInternal
+};
+
+enum class CapturePipeline : uint8_t
+{
+    Triangle,
+    Classic,
+    Meshlet,
+    Cull,
+};
+
+#pragma pack(push, 1)
+struct CaptureHeader
+{
+    uint32_t magic          = CAPTURE_MAGIC;
+    uint32_t version        = CAPTURE_VERSION;
+    uint32_t viewCount      = 0;
+    uint32_t uploadCount    = 0;
+    uint8_t  meshletScene   = 0;
+    uint8_t  renderPath     = 0;    // RenderPath at the start of the capture
+    uint8_t  meshletPath    = 0;    // RenderPath the meshlet pipeline was built for
+    uint8_t  dynamicResolution = 0;
+    uint8_t  msaaSamples    = 1;
+};
+
+struct CaptureView
+{
+    uint32_t width;
+    uint32_t height;
+    uint8_t  windowed;
+};
+
+// Device local buffers created for the scene. Only their hash is kept, the replay rebuilds the
+// scene and checks it uploaded the same data
+struct CaptureUpload
+{
+    uint64_t size;
+    uint64_t hash;  // FNV-1a 64
+};
+
+struct CaptureFrame
+{
+    uint64_t frameIndex;
+    float    cpuMs;         // drawFrame time when it was captured
+    uint32_t commandBytes;  // Size of the commands that follow
+};
+
+struct CmdBeginView         { uint32_t view; };
+struct CmdImageBarrier      { uint32_t view; CaptureImage image; uint32_t oldLayout, newLayout; uint64_t srcAccess, dstAccess, srcStage, dstStage; };
+struct CmdMemoryBarrier     { uint64_t srcStage, srcAccess, dstStage, dstAccess; };
+struct CmdBeginRendering    { uint32_t view; CaptureImage image; uint32_t width, height; };
+struct CmdBindPipeline      { CapturePipeline pipeline; uint8_t features = 0; };   // Shader variant (see ShaderVariants.h)
+struct CmdDraw              { uint32_t count; };
+struct CmdTimestamp         { uint64_t stage; uint32_t query, count; };
+struct CmdBlit              { uint32_t view; uint32_t srcWidth, srcHeight; };
+#pragma pack(pop)
+
+uint64_t hashBytes(const void* data, size_t size);
+
+// Appends the commands of a frame to memory and writes the frame in one go at the end
+class FrameRecorder
+{
+public:
+    void open(const std::string& path, const CaptureHeader& header,
+        const std::vector<CaptureView>& views, const std::vector<CaptureUpload>& uploads);
+    void close();
+    bool isRecording() const { return file.is_open(); }
+
+    void beginFrame(uint64_t frameIndex);
+    void endFrame(float cpuMs);
+
+    template <typename T>
+    void write(FrameOp op, const T& payload)
+    {
+        write(op);
+        size_t offset = commands.size();
+        commands.resize(offset + sizeof(T));
+        memcpy(commands.data() + offset, &payload, sizeof(T));
+    }
+    void write(FrameOp op) { commands.push_back(static_cast<uint8_t>(op)); }
+
+    uint64_t getFrameCount() const { return frameCount; }
+
+private:
+    std::ofstream           file;
+    std::vector<uint8_t>    commands;
+    uint64_t                frameIndex = 0;
+    uint64_t                frameCount = 0;
+};
+
+struct CapturedFrame
+{
+    uint64_t                frameIndex = 0;
+    float                   cpuMs      = 0.f;
+    std::vector<uint8_t>    commands;
+};
+
+// Loads a whole capture in memory, the replay doesn't touch the disk while timing
+class FrameCapture
+{
+public:
+    explicit FrameCapture(const std::string& path);
+
+    CaptureHeader               header;
+    std::vector<CaptureView>    views;
+    std::vector<CaptureUpload>  uploads;
+    std::vector<CapturedFrame>  frames;
+};
+
+// Walks the commands of a captured frame
+class FrameOpReader
+{
+public:
+    explicit FrameOpReader(const std::vector<uint8_t>& commands_) : commands(commands_) {}
+
+    bool    atEnd() const { return offset >= commands.size(); }
+    FrameOp nextOp() { return static_cast<FrameOp>(commands[offset++]); }
+
+    template <typename T>
+    T read()
+    {
+        if (offset + sizeof(T) > commands.size())
+            throw std::runtime_error("truncated frame capture");
+
+        T payload;
+        memcpy(&payload, commands.data() + offset, sizeof(T));
+        offset += sizeof(T);
+        return payload;
+    }
+
+private:
+    const std::vector<uint8_t>& commands;
+    size_t offset = 0;
+};
@@ -0,0 +1,158 @@
+#include "InitScheduler.h"
+#include "Trace.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+InitScheduler::StepId InitScheduler::add(const char* name, std::function<void()> work, std::initializer_list<StepId> dependsOn, bool mainThread)
+{
+    StepId id = static_cast<StepId>(steps.size());
+    for (StepId dependency : dependsOn)
+    {
+        if (dependency >= id)
+            throw std::runtime_error(std::string("init step ") + name + " depends on a step added after it");
+    }
+
+    Step step;
+    step.name       = name;
+    step.work       = std::move(work);
+    step.dependsOn  = dependsOn;
+    step.mainThread = mainThread;
+    steps.push_back(std::move(step));
+
+    return id;
+}
+
+void InitScheduler::run(bool parallel_)
+{
+    using Clock = std::chrono::high_resolution_clock;
+
+    parallel = parallel_;
+    auto start = Clock::now();
+
+    std::mutex              mutex;
+    std::condition_variable cv;
+    std::vector<bool>       started(steps.size(), false);
+    std::vector<std::thread> threads;
+    std::exception_ptr      error;
+    size_t                  running = 0;
+
+    auto execute = [&](StepId id, bool onWorker)
+    {
+        Step& step = steps[id];
+        if (onWorker)
+            Trace::setThreadName(std::string("init ") + step.name);
+
+        uint64_t traceStart = Trace::now();
+        auto t0 = Clock::now();
+
+        std::exception_ptr stepError;
+        try
+        {
+            step.work();
+        }
+        catch (...)
+        {
+            stepError = std::current_exception();
+        }
+
+        auto t1 = Clock::now();
+        Trace::complete(step.name, "init", traceStart, Trace::now() - traceStart);
+
+        std::lock_guard lock(mutex);
+        step.startMs    = std::chrono::duration<double, std::milli>(t0 - start).count();
+        step.durationMs = std::chrono::duration<double, std::milli>(t1 - t0).count();
+        step.onWorker   = onWorker;
+        step.done       = !stepError;
+        if (stepError && !error)
+            error = stepError;
+        running--;
+        cv.notify_all();
+    };
+
+    auto isReady = [&](const Step& step)
+    {
+        for (StepId dependency : step.dependsOn)
+        {
+            if (!steps[dependency].done)
+                return false;
+        }
+        return true;
+    };
+
+    {
+        std::unique_lock lock(mutex);
+        while (!error)
+        {
+            size_t finished = 0;
+            for (const auto& step : steps)
+                finished += step.done ? 1 : 0;
+            if (finished == steps.size())
+                break;
+
+            // Hand every ready step to a worker, except the first one that has to run here
+            const StepId none = ~0u;
+            StepId here = none;
+            for (StepId id = 0; id < steps.size(); id++)
+            {
+                if (started[id] || !isReady(steps[id]))
+                    continue;
+
+                if (!parallel || steps[id].mainThread)
+                {
+                    if (here == none)
+                        here = id;
+                    continue;
+                }
+
+                started[id] = true;
+                running++;
+                threads.emplace_back(execute, id, true);
+            }
+
+            if (here != none)
+            {
+                started[here] = true;
+                running++;
+                lock.unlock();
+                execute(here, false);
+                lock.lock();
+                continue;
+            }
+
+            // Nothing to run here, wait for a worker to finish a step
+            cv.wait(lock);
+        }
+
+        cv.wait(lock, [&]() { return running == 0; });
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+
+    wallMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+void InitScheduler::printReport(std::ostream& out) const
+{
+    double stepsMs = 0.0;
+    for (const auto& step : steps)
+        stepsMs += step.durationMs;
+
+    out << "startup: " << wallMs << " ms, " << stepsMs << " ms of steps"
+        << (parallel ? "" : " (serial)") << std::endl;
+
+    for (const auto& step : steps)
+    {
+        out << "  " << step.name << ": " << step.startMs << " -> " << step.startMs + step.durationMs
+            << " ms (" << step.durationMs << " ms, " << (step.onWorker ? "worker" : "main thread") << ")" << std::endl;
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <ostream>
+#include <vector>
+
+// Startup steps and their dependencies. run() starts every step as soon as the ones it depends
+// on are done: independent steps overlap on worker threads, the ones that have to stay on the
+// calling thread (GLFW window calls) run there. Every step is timed for the startup report
+class InitScheduler
+{
+public:
+    using StepId = uint32_t;
+
+    // A step can only depend on steps added before it, so the steps always complete.
+    // The name has to outlive the scheduler (it's also the name of the trace event)
+    StepId add(const char* name, std::function<void()> work, std::initializer_list<StepId> dependsOn = {}, bool mainThread = false);
+
+    // Not parallel runs the steps one after the other in the order they were added, on the calling thread.
+    // The first exception of a step is rethrown once the running steps are done, the steps left aren't started
+    void run(bool parallel = true);
+
+    double getWallMs() const { return wallMs; }
+
+    // Start and duration of every step, and the time saved by overlapping them
+    void printReport(std::ostream& out) const;
+
+private:
+    struct Step
+    {
+        const char*             name = nullptr;
+        std::function<void()>   work;
+        std::vector<StepId>     dependsOn;
+        bool                    mainThread  = false;
+
+        double  startMs     = 0.0;  // Since the start of run
+        double  durationMs  = 0.0;
+        bool    onWorker    = false;
+        bool    done        = false;
+    };
+
+    std::vector<Step>   steps;
+    double              wallMs   = 0.0;
+    bool                parallel = true;
+};
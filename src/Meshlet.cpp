@@ -0,0 +1,152 @@
+#include "Meshlet.h"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+static MeshletBounds computeBounds(const MeshletMesh& mesh, const Meshlet& meshlet, const std::vector<MeshVertex>& vertices)
+{
+    MeshletBounds bounds{};
+
+    // Bounding sphere: centroid of the vertices and the furthest vertex as the radius
+    glm::vec3 center(0.f);
+    for (uint32_t i = 0; i < meshlet.vertexCount; i++)
+        center += glm::vec3(vertices[mesh.meshletVertices[meshlet.vertexOffset + i]].position);
+    center /= static_cast<float>(meshlet.vertexCount);
+
+    float radius = 0.f;
+    for (uint32_t i = 0; i < meshlet.vertexCount; i++)
+        radius = std::max(radius, glm::length(glm::vec3(vertices[mesh.meshletVertices[meshlet.vertexOffset + i]].position) - center));
+
+    bounds.sphere = glm::vec4(center, radius);
+
+    // Normal cone: average of the face normals, and the widest deviation from it
+    std::vector<glm::vec3> normals(meshlet.triangleCount);
+    glm::vec3 axis(0.f);
+    for (uint32_t t = 0; t < meshlet.triangleCount; t++)
+    {
+        uint32_t packed = mesh.meshletTriangles[meshlet.triangleOffset + t];
+        const MeshVertex& a = vertices[mesh.meshletVertices[meshlet.vertexOffset + (packed & 0xFF)]];
+        const MeshVertex& b = vertices[mesh.meshletVertices[meshlet.vertexOffset + ((packed >> 8) & 0xFF)]];
+        const MeshVertex& c = vertices[mesh.meshletVertices[meshlet.vertexOffset + ((packed >> 16) & 0xFF)]];
+
+        glm::vec3 n = glm::cross(glm::vec3(b.position - a.position), glm::vec3(c.position - a.position));
+        float len = glm::length(n);
+        n = len > 0.f ? n / len : glm::vec3(0.f);
+
+        // Orient the face normal like the vertex normals, whatever the winding is
+        if (glm::dot(n, glm::vec3(a.normal)) < 0.f)
+            n = -n;
+
+        normals[t] = n;
+        axis += n;
+    }
+
+    float axisLen = glm::length(axis);
+    axis = axisLen > 0.f ? axis / axisLen : glm::vec3(0.f, 0.f, 1.f);
+
+    float minDot = 1.f;
+    for (const auto& n : normals)
+        minDot = std::min(minDot, glm::dot(axis, n));
+
+    // A cone wider than ~85 degrees can never be fully back-facing, so disable it
+    float cutoff = minDot <= 0.1f ? 2.f : std::sqrt(1.f - minDot * minDot);
+    bounds.cone = glm::vec4(axis, cutoff);
+
+    return bounds;
+}
+
+MeshletMesh buildMeshlets(const std::vector<MeshVertex>& vertices, const std::vector<uint32_t>& indices)
+{
+    MeshletMesh mesh;
+
+    // Maps a global vertex to its index inside the current meshlet (~0u if not in it)
+    std::vector<uint32_t> localIndex(vertices.size(), ~0u);
+
+    Meshlet current{};
+    auto flush = [&]()
+    {
+        if (current.triangleCount == 0)
+            return;
+
+        for (uint32_t i = 0; i < current.vertexCount; i++)
+            localIndex[mesh.meshletVertices[current.vertexOffset + i]] = ~0u;
+
+        mesh.bounds.push_back(computeBounds(mesh, current, vertices));
+        mesh.meshlets.push_back(current);
+
+        current                 = {};
+        current.vertexOffset    = static_cast<uint32_t>(mesh.meshletVertices.size());
+        current.triangleOffset  = static_cast<uint32_t>(mesh.meshletTriangles.size());
+    };
+
+    // Greedy split: fill the meshlet in index order until either limit is hit
+    for (size_t t = 0; t + 2 < indices.size(); t += 3)
+    {
+        uint32_t newVertices = 0;
+        for (size_t k = 0; k < 3; k++)
+        {
+            if (localIndex[indices[t + k]] == ~0u)
+                newVertices++;
+        }
+
+        if (current.vertexCount + newVertices > MESHLET_MAX_VERTICES || current.triangleCount + 1 > MESHLET_MAX_TRIANGLES)
+            flush();
+
+        uint32_t local[3];
+        for (size_t k = 0; k < 3; k++)
+        {
+            uint32_t idx = indices[t + k];
+            if (localIndex[idx] == ~0u)
+            {
+                localIndex[idx] = current.vertexCount++;
+                mesh.meshletVertices.push_back(idx);
+            }
+            local[k] = localIndex[idx];
+        }
+
+        mesh.meshletTriangles.push_back(local[0] | (local[1] << 8) | (local[2] << 16));
+        current.triangleCount++;
+    }
+
+    flush();
+
+    return mesh;
+}
+
+void generateSphere(unsigned rings, unsigned segments, float radius,
+    std::vector<MeshVertex>& vertices,
+    std::vector<uint32_t>& indices)
+{
+    vertices.clear();
+    indices.clear();
+    vertices.reserve(static_cast<size_t>(rings + 1) * (segments + 1));
+    indices.reserve(static_cast<size_t>(rings) * segments * 6);
+
+    for (unsigned i = 0; i <= rings; i++)
+    {
+        float theta = glm::pi<float>() * static_cast<float>(i) / static_cast<float>(rings);
+        for (unsigned j = 0; j <= segments; j++)
+        {
+            float phi = glm::two_pi<float>() * static_cast<float>(j) / static_cast<float>(segments);
+
+            glm::vec3 n(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+            vertices.push_back({ glm::vec4(n * radius, 1.f), glm::vec4(n, 0.f) });
+        }
+    }
+
+    // Counter-clockwise when seen from the outside
+    for (unsigned i = 0; i < rings; i++)
+    {
+        for (unsigned j = 0; j < segments; j++)
+        {
+            uint32_t a = i * (segments + 1) + j;
+            uint32_t b = (i + 1) * (segments + 1) + j;
+            uint32_t c = b + 1;
+            uint32_t d = a + 1;
+
+            indices.insert(indices.end(), { a, c, b, a, d, c });
+        }
+    }
+}
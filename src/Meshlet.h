@@ -0,0 +1,48 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+// Limits of a single meshlet. 64/124 is the sweet spot recommended by most vendors
+// and fits in the max_vertices/max_primitives of "meshlet.mesh"
+constexpr uint32_t MESHLET_MAX_VERTICES  = 64;
+constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+// Vertex layout shared by the classic vertex input and the storage buffers (std430 friendly)
+struct MeshVertex
+{
+    glm::vec4 position;
+    glm::vec4 normal;
+};
+
+struct Meshlet
+{
+    uint32_t vertexOffset;      // First entry in MeshletMesh::meshletVertices
+    uint32_t triangleOffset;    // First entry in MeshletMesh::meshletTriangles
+    uint32_t vertexCount;
+    uint32_t triangleCount;
+};
+
+struct MeshletBounds
+{
+    glm::vec4 sphere;   // xyz = center, w = radius
+    glm::vec4 cone;     // xyz = normal cone axis, w = cutoff (> 1 means the cone can't be culled)
+};
+
+struct MeshletMesh
+{
+    std::vector<Meshlet>        meshlets;
+    std::vector<MeshletBounds>  bounds;
+    std::vector<uint32_t>       meshletVertices;    // Indices into the vertex buffer
+    std::vector<uint32_t>       meshletTriangles;   // 3 local (8 bit) indices packed per triangle
+};
+
+// Splits an indexed triangle list into meshlets and computes their culling bounds
+MeshletMesh buildMeshlets(const std::vector<MeshVertex>& vertices, const std::vector<uint32_t>& indices);
+
+// Generates a UV sphere, used as test geometry for the meshlet/classic paths
+void generateSphere(unsigned rings, unsigned segments, float radius,
+    std::vector<MeshVertex>& vertices,
+    std::vector<uint32_t>& indices);
@@ -0,0 +1,242 @@
+#include "RenderFarm.h"
+#include "Trace.h"
+#include "ResourceTracker.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <thread>
+
+unsigned RenderFarm::countPhysicalDevices()
+{
+    // Throwaway instance, only to know how many devices the loader exposes
+    VkApplicationInfo appInfo{};
+    appInfo.sType       = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    appInfo.apiVersion  = VK_API_VERSION_1_3;
+
+    VkInstanceCreateInfo createInfo{};
+    createInfo.sType            = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    createInfo.pApplicationInfo = &appInfo;
+
+    VkInstance instance;
+    if (vkCreateInstance(&createInfo, ResourceTracker::allocator(), &instance) != VK_SUCCESS)
+        throw std::runtime_error("failed to create the instance");
+    ResourceTracker::created(VK_OBJECT_TYPE_INSTANCE, instance);
+
+    unsigned deviceCount = 0;
+    vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
+    ResourceTracker::destroyed(VK_OBJECT_TYPE_INSTANCE, instance);
+    vkDestroyInstance(instance, ResourceTracker::allocator());
+
+    return deviceCount;
+}
+
+RenderFarm::RenderFarm(unsigned width_, unsigned height_, bool enableLayer, const DebugFilter& debugFilter, bool meshletScene, unsigned workersPerDevice)
+    : width(width_), height(height_)
+{
+    unsigned deviceCount = countPhysicalDevices();
+
+    for (unsigned i = 0; i < deviceCount; i++)
+    {
+        for (unsigned w = 0; w < workersPerDevice; w++)
+        {
+            Worker worker;
+            worker.setUp        = std::make_unique<VKSetUp>();
+            worker.deviceIndex  = i;
+            worker.enableLayer  = enableLayer;
+
+            // Pin the worker to the i-th device through the selection override
+            VKSetUp& setUp = *worker.setUp;
+            setUp.addHeadlessView(width, height);
+            setUp.enableReadback(true);
+            setUp.enableMeshletScene(meshletScene);
+            setUp.setDeviceOverride(std::to_string(i));
+            setUp.setDebugFilter(debugFilter);
+
+            try
+            {
+                setUp.createInstance(enableLayer);
+                setUp.setupDebugMessenger(enableLayer);
+                setUp.pickPhysicalDevice();
+                setUp.createLogicalDevice();
+                setUp.createSwapChain();
+                setUp.createImageViews();
+                setUp.createGraphicsPipeline();
+                setUp.createCommandPool();
+                setUp.createCommandBuffer();
+                setUp.createSyncObjs();
+                setUp.createMeshletScene();
+            }
+            catch (const std::exception& e)
+            {
+                // Unsuitable devices are skipped, the farm uses whatever is left. What the init
+                // created before it threw is released with the setUp
+                std::cerr << "render farm: skipping GPU " << i << ": " << e.what() << std::endl;
+                if (enableLayer)
+                    setUp.destroyDebugMessenger();
+                setUp.cleanup();
+                break;
+            }
+
+            worker.deviceName = setUp.getCapabilities().name;
+            workers.push_back(std::move(worker));
+        }
+    }
+
+    if (workers.empty())
+        throw std::runtime_error("render farm: no suitable GPU");
+}
+
+RenderFarm::~RenderFarm()
+{
+    for (auto& worker : workers)
+    {
+        vkDeviceWaitIdle(worker.setUp->getDevice());
+        if (worker.enableLayer)
+            worker.setUp->destroyDebugMessenger();
+        worker.setUp->cleanup();
+    }
+}
+
+void RenderFarm::run(uint32_t frameCount, const FrameCallback& onFrame)
+{
+    // Frames rendered out of order wait here until every frame before them was delivered.
+    // Workers can't run further ahead than the window, which bounds the memory used
+    const uint32_t reorderWindow = static_cast<uint32_t>(workers.size()) * 2;
+
+    std::atomic<uint32_t>   nextFrame{ 0 };
+    std::mutex              mutex;
+    std::condition_variable cv;
+    std::map<uint32_t, std::vector<uint8_t>> pending;
+    uint32_t                delivered = 0;
+    bool                    failed    = false;
+    std::exception_ptr      error;
+
+    for (auto& worker : workers)
+    {
+        worker.frames = 0;
+        worker.busyMs = 0.0;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::vector<std::thread> threads;
+    for (auto& worker : workers)
+    {
+        threads.emplace_back([&, w = &worker]()
+        {
+            Trace::setThreadName("farm worker " + std::to_string(w - workers.data()) + " (GPU " + std::to_string(w->deviceIndex) + ")");
+
+            try
+            {
+                std::vector<uint8_t> pixels;
+                for (uint32_t frame = nextFrame++; frame < frameCount; frame = nextFrame++)
+                {
+                    {
+                        TRACE_SCOPE("wait reorder window", "farm", frame);
+                        std::unique_lock lock(mutex);
+                        cv.wait(lock, [&]() { return frame < delivered + reorderWindow || failed; });
+                        if (failed)
+                            return;
+                    }
+
+                    TRACE_SCOPE("farm frame", "farm", frame);
+                    auto t0 = std::chrono::high_resolution_clock::now();
+                    w->setUp->setFrameIndex(frame);
+                    w->setUp->drawFrame();
+                    w->setUp->copyViewPixels(0, pixels);
+                    auto t1 = std::chrono::high_resolution_clock::now();
+
+                    w->frames++;
+                    w->busyMs += std::chrono::duration<double, std::milli>(t1 - t0).count();
+
+                    {
+                        std::lock_guard lock(mutex);
+                        pending[frame] = std::move(pixels);
+                    }
+                    cv.notify_all();
+                }
+            }
+            catch (...)
+            {
+                std::lock_guard lock(mutex);
+                if (!failed)
+                    error = std::current_exception();
+                failed = true;
+                cv.notify_all();
+            }
+        });
+    }
+
+    // Deliver in order from this thread
+    {
+        std::unique_lock lock(mutex);
+        while (delivered < frameCount)
+        {
+            cv.wait(lock, [&]() { return pending.count(delivered) > 0 || failed; });
+            if (failed)
+                break;
+
+            auto node = pending.extract(delivered);
+            lock.unlock();
+            try
+            {
+                TRACE_SCOPE("deliver frame", "farm", delivered);
+                onFrame(delivered, node.mapped());
+            }
+            catch (...)
+            {
+                // Stops the workers, they're joined before the exception goes up
+                lock.lock();
+                if (!failed)
+                    error = std::current_exception();
+                failed = true;
+                cv.notify_all();
+                break;
+            }
+
+            // Keeps the rings of the workers from filling up on long runs, the collected events are capped
+            if (delivered % 256 == 255 && Trace::isEnabled())
+                Trace::collect();
+            lock.lock();
+
+            delivered++;
+            cv.notify_all();
+        }
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+
+    if (error)
+        std::rethrow_exception(error);
+
+    auto end = std::chrono::high_resolution_clock::now();
+    lastFrameCount  = frameCount;
+    lastWallMs      = std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void RenderFarm::printReport() const
+{
+    double seconds = lastWallMs / 1000.0;
+
+    std::cout << "render farm: " << lastFrameCount << " frames of " << width << "x" << height
+        << " in " << seconds << " s (" << lastFrameCount / seconds << " frames/s) on "
+        << workers.size() << " workers" << std::endl;
+
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        const Worker& worker = workers[i];
+        double avgMs = worker.frames ? worker.busyMs / worker.frames : 0.0;
+
+        std::cout << "  worker " << i << " on GPU " << worker.deviceIndex << " (" << worker.deviceName << "): "
+            << worker.frames << " frames, " << avgMs << " ms/frame, "
+            << 100.0 * worker.busyMs / lastWallMs << "% busy" << std::endl;
+
+        if (worker.enableLayer)
+            worker.setUp->getDebugSink().printReport(std::cout);
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "VulkanSetUp.h"
+
+#include <functional>
+#include <memory>
+
+// Offline batch rendering: one headless VKSetUp (instance + logical device) per worker,
+// with workers on every suitable physical device. Frames are handed out dynamically, so
+// faster devices take more of them, and delivered back to the caller in order
+class RenderFarm
+{
+public:
+    using FrameCallback = std::function<void(uint32_t frame, const std::vector<uint8_t>& pixels)>;
+
+    // workersPerDevice > 1 creates several logical devices on the same GPU, which is what
+    // scales a software ICD such as lavapipe across the CPU cores
+    RenderFarm(unsigned width, unsigned height, bool enableLayer, const DebugFilter& debugFilter, bool meshletScene, unsigned workersPerDevice);
+    ~RenderFarm();
+
+    // Renders frames [0, frameCount) and calls onFrame for each of them, in order, from the calling thread
+    void run(uint32_t frameCount, const FrameCallback& onFrame);
+
+    // Aggregate throughput and per device utilization of the last run, and the validation messages of the workers
+    void printReport() const;
+
+    size_t getWorkerCount() const { return workers.size(); }
+
+private:
+    struct Worker
+    {
+        std::unique_ptr<VKSetUp> setUp;
+        unsigned    deviceIndex = 0;
+        std::string deviceName;
+        bool        enableLayer = false;
+
+        uint32_t    frames = 0;
+        double      busyMs = 0.0;   // Time spent rendering and reading back frames
+    };
+
+    static unsigned countPhysicalDevices();
+
+    std::vector<Worker> workers;
+    unsigned    width;
+    unsigned    height;
+    uint32_t    lastFrameCount = 0;
+    double      lastWallMs     = 0.0;
+};
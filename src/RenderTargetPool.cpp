@@ -0,0 +1,283 @@
+#include "RenderTargetPool.h"
+#include "ResourceTracker.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+// Usages that let an image be a transient attachment
+static constexpr VkImageUsageFlags ATTACHMENT_USAGES = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                                                       VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                                                       VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+
+static constexpr VkAccessFlags2 WRITE_ACCESSES = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+                                                 VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+                                                 VK_ACCESS_2_TRANSFER_WRITE_BIT |
+                                                 VK_ACCESS_2_SHADER_WRITE_BIT;
+
+static bool overlaps(const RenderTargetDesc& a, const RenderTargetDesc& b)
+{
+    return a.firstPass <= b.lastPass && b.firstPass <= a.lastPass;
+}
+
+static int findMemoryType(const VkPhysicalDeviceMemoryProperties& props, uint32_t typeBits, VkMemoryPropertyFlags flags)
+{
+    for (uint32_t i = 0; i < props.memoryTypeCount; i++)
+    {
+        if ((typeBits & (1u << i)) && (props.memoryTypes[i].propertyFlags & flags) == flags)
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+RenderTargetHandle RenderTargetPool::add(const RenderTargetDesc& desc)
+{
+    if (device)
+        throw std::runtime_error("render target pool: targets have to be added before build");
+    if (desc.firstPass > desc.lastPass)
+        throw std::runtime_error(std::string("render target pool: empty pass range for ") + desc.name);
+
+    Target target;
+    target.desc = desc;
+    targets.push_back(target);
+
+    return static_cast<RenderTargetHandle>(targets.size() - 1);
+}
+
+bool RenderTargetPool::transient(const RenderTargetDesc& desc) const
+{
+    return !desc.consumed && (desc.usage & ~ATTACHMENT_USAGES) == 0;
+}
+
+void RenderTargetPool::build(VkDevice device_, VkPhysicalDevice physicalDevice)
+{
+    device = device_;
+
+    VkPhysicalDeviceMemoryProperties memProps;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProps);
+
+    for (auto& target : targets)
+    {
+        const RenderTargetDesc& desc = target.desc;
+
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType     = VK_IMAGE_TYPE_2D;
+        imageInfo.format        = desc.format;
+        imageInfo.extent        = { desc.extent.width, desc.extent.height, 1 };
+        imageInfo.mipLevels     = 1;
+        imageInfo.arrayLayers   = 1;
+        imageInfo.samples       = desc.samples;
+        imageInfo.tiling        = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage         = desc.usage | (transient(desc) ? VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT : 0);
+        imageInfo.sharingMode   = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        if (vkCreateImage(device, &imageInfo, ResourceTracker::allocator(), &target.image) != VK_SUCCESS)
+            throw std::runtime_error(std::string("render target pool: failed to create ") + desc.name);
+        ResourceTracker::created(VK_OBJECT_TYPE_IMAGE, target.image);
+
+        VkMemoryRequirements memReq;
+        vkGetImageMemoryRequirements(device, target.image, &memReq);
+        target.size = memReq.size;
+
+        // Lazily allocated memory gets its own allocation, the driver may never back it
+        target.lazy = transient(desc) && findMemoryType(memProps, memReq.memoryTypeBits,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) >= 0;
+
+        Slot slot;
+        slot.size       = memReq.size;
+        slot.alignment  = memReq.alignment;
+        slot.typeBits   = memReq.memoryTypeBits;
+        slot.lazy       = target.lazy;
+        slots.push_back(slot);
+        target.slot = static_cast<uint32_t>(slots.size() - 1);
+    }
+
+    // Greedy packing, biggest targets first: a target joins the first slot it's compatible with and
+    // whose users are all done before it starts (or start after it ends)
+    std::vector<RenderTargetHandle> order(targets.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](RenderTargetHandle a, RenderTargetHandle b) { return targets[a].size > targets[b].size; });
+
+    std::vector<uint32_t> packed;
+    for (RenderTargetHandle handle : order)
+    {
+        Target& target = targets[handle];
+        Slot&   own    = slots[target.slot];
+
+        bool placed = false;
+        for (uint32_t s : packed)
+        {
+            Slot& slot = slots[s];
+            if (target.lazy || slot.lazy || (slot.typeBits & own.typeBits) == 0)
+                continue;
+
+            bool free = std::none_of(slot.users.begin(), slot.users.end(),
+                [&](RenderTargetHandle user) { return overlaps(targets[user].desc, target.desc); });
+            if (!free)
+                continue;
+
+            slot.size       = std::max(slot.size, own.size);
+            slot.alignment  = std::max(slot.alignment, own.alignment);
+            slot.typeBits  &= own.typeBits;
+            slot.users.push_back(handle);
+            own.users.clear();
+            target.slot = s;
+            placed = true;
+            break;
+        }
+
+        if (!placed)
+        {
+            own.users = { handle };
+            packed.push_back(target.slot);
+        }
+    }
+
+    for (auto& slot : slots)
+    {
+        if (slot.users.empty())
+            continue;
+
+        VkMemoryPropertyFlags flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | (slot.lazy ? VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT : 0);
+        int type = findMemoryType(memProps, slot.typeBits, flags);
+        if (type < 0)
+            throw std::runtime_error("render target pool: no device local memory type for the targets");
+
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType             = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize    = slot.size;
+        allocInfo.memoryTypeIndex   = static_cast<uint32_t>(type);
+
+        if (vkAllocateMemory(device, &allocInfo, ResourceTracker::allocator(), &slot.memory) != VK_SUCCESS)
+            throw std::runtime_error("render target pool: failed to allocate the target memory");
+        ResourceTracker::allocated(slot.memory, allocInfo.allocationSize);
+    }
+
+    for (auto& target : targets)
+    {
+        const RenderTargetDesc& desc = target.desc;
+        vkBindImageMemory(device, target.image, slots[target.slot].memory, 0);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType                              = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image                              = target.image;
+        viewInfo.viewType                           = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format                             = desc.format;
+        viewInfo.subresourceRange.aspectMask        = desc.aspect;
+        viewInfo.subresourceRange.baseMipLevel      = 0;
+        viewInfo.subresourceRange.levelCount        = 1;
+        viewInfo.subresourceRange.baseArrayLayer    = 0;
+        viewInfo.subresourceRange.layerCount        = 1;
+
+        if (vkCreateImageView(device, &viewInfo, ResourceTracker::allocator(), &target.view) != VK_SUCCESS)
+            throw std::runtime_error(std::string("render target pool: failed to create the view of ") + desc.name);
+        ResourceTracker::created(VK_OBJECT_TYPE_IMAGE_VIEW, target.view);
+    }
+}
+
+void RenderTargetPool::destroy()
+{
+    if (!device)
+        return;
+
+    for (auto& target : targets)
+    {
+        ResourceTracker::destroyed(VK_OBJECT_TYPE_IMAGE_VIEW, target.view);
+        vkDestroyImageView(device, target.view, ResourceTracker::allocator());
+        ResourceTracker::destroyed(VK_OBJECT_TYPE_IMAGE, target.image);
+        vkDestroyImage(device, target.image, ResourceTracker::allocator());
+    }
+    for (auto& slot : slots)
+    {
+        ResourceTracker::freed(slot.memory);
+        vkFreeMemory(device, slot.memory, ResourceTracker::allocator());
+    }
+
+    targets.clear();
+    slots.clear();
+    device = nullptr;
+}
+
+VkAttachmentStoreOp RenderTargetPool::storeOp(RenderTargetHandle target) const
+{
+    return targets.at(target).desc.consumed ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+}
+
+VkPipelineStageFlags2 RenderTargetPool::aliasStages(RenderTargetHandle target) const
+{
+    const Target& self = targets.at(target);
+
+    VkPipelineStageFlags2 stages = 0;
+    for (RenderTargetHandle user : slots[self.slot].users)
+    {
+        if (targets[user].desc.lastPass < self.desc.firstPass)
+            stages |= targets[user].desc.stages;
+    }
+    return stages;
+}
+
+VkAccessFlags2 RenderTargetPool::aliasAccess(RenderTargetHandle target) const
+{
+    const Target& self = targets.at(target);
+
+    VkAccessFlags2 access = 0;
+    for (RenderTargetHandle user : slots[self.slot].users)
+    {
+        if (targets[user].desc.lastPass < self.desc.firstPass)
+            access |= targets[user].desc.access & WRITE_ACCESSES;
+    }
+    return access;
+}
+
+RenderTargetPool::Footprint RenderTargetPool::getFootprint() const
+{
+    Footprint footprint;
+    footprint.targets = static_cast<uint32_t>(targets.size());
+
+    for (const auto& target : targets)
+        footprint.requested += target.size;
+
+    for (const auto& slot : slots)
+    {
+        if (!slot.memory)
+            continue;
+
+        footprint.allocations++;
+        footprint.allocated += slot.size;
+        if (slot.lazy)
+        {
+            VkDeviceSize committed = 0;
+            vkGetDeviceMemoryCommitment(device, slot.memory, &committed);
+            footprint.lazy          += slot.size;
+            footprint.lazyCommitted += committed;
+        }
+    }
+
+    return footprint;
+}
+
+void RenderTargetPool::printReport(std::ostream& out) const
+{
+    if (targets.empty())
+        return;
+
+    auto mib = [](VkDeviceSize bytes) { return static_cast<double>(bytes) / (1024.0 * 1024.0); };
+
+    Footprint footprint = getFootprint();
+    out << "render targets: " << footprint.targets << " targets in " << footprint.allocations << " allocations, "
+        << mib(footprint.allocated) << " MiB per frame instead of " << mib(footprint.requested) << " MiB";
+    if (footprint.lazy)
+        out << " (" << mib(footprint.lazy) << " MiB lazily allocated, " << mib(footprint.lazyCommitted) << " MiB committed)";
+    out << std::endl;
+
+    for (const auto& target : targets)
+    {
+        out << "  " << target.desc.name << ": " << target.desc.extent.width << "x" << target.desc.extent.height
+            << ", " << mib(target.size) << " MiB, passes " << target.desc.firstPass << "-" << target.desc.lastPass
+            << (target.desc.consumed ? ", stored" : ", never stored")
+            << (target.lazy ? ", lazily allocated" : "")
+            << ", memory " << target.slot << std::endl;
+    }
+}
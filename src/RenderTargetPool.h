@@ -0,0 +1,100 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+using RenderTargetHandle = uint32_t;
+constexpr RenderTargetHandle NO_RENDER_TARGET = ~0u;
+
+// A render target of the frame and the passes that use it. Passes are numbered in submission
+// order across the whole frame, every view included
+struct RenderTargetDesc
+{
+    const char*             name    = "";
+    VkFormat                format  = VK_FORMAT_UNDEFINED;
+    VkExtent2D              extent{};
+    VkSampleCountFlagBits   samples = VK_SAMPLE_COUNT_1_BIT;
+    VkImageUsageFlags       usage   = 0;
+    VkImageAspectFlags      aspect  = VK_IMAGE_ASPECT_COLOR_BIT;
+
+    uint32_t firstPass = 0;     // Inclusive range of the passes using the target
+    uint32_t lastPass  = 0;
+    bool     consumed  = false; // Read after its last write (blit, resolve, copy...). If not, it's never stored
+
+    VkPipelineStageFlags2   stages = 0;     // Every stage/access the target is used with, for the aliasing barriers
+    VkAccessFlags2          access = 0;
+};
+
+// Per frame render targets. Targets whose pass ranges don't overlap share the same memory, targets
+// that are never stored get TRANSIENT_ATTACHMENT usage and lazily allocated memory when the device
+// has it (tilers only commit tile memory for them). Nothing here survives across frames: every first
+// use has to start from UNDEFINED, after waiting for aliasStages/aliasAccess
+class RenderTargetPool
+{
+public:
+    RenderTargetPool() = default;
+
+    RenderTargetPool(const RenderTargetPool&)            = delete;
+    RenderTargetPool& operator=(const RenderTargetPool&) = delete;
+
+    // Targets are added first, then everything is created at once
+    RenderTargetHandle  add(const RenderTargetDesc& desc);
+    void                build(VkDevice device, VkPhysicalDevice physicalDevice);
+    void                destroy();
+    bool                empty() const { return targets.empty(); }
+
+    VkImage             getImage(RenderTargetHandle target) const { return targets.at(target).image; }
+    VkImageView         getView(RenderTargetHandle target) const  { return targets.at(target).view; }
+    const RenderTargetDesc& getDesc(RenderTargetHandle target) const { return targets.at(target).desc; }
+
+    // DONT_CARE unless something reads the target after the pass
+    VkAttachmentStoreOp storeOp(RenderTargetHandle target) const;
+
+    // What the earlier users of the target's memory in the frame did, the first barrier waits for it
+    VkPipelineStageFlags2   aliasStages(RenderTargetHandle target) const;
+    VkAccessFlags2          aliasAccess(RenderTargetHandle target) const;
+
+    struct Footprint
+    {
+        uint32_t        targets         = 0;
+        uint32_t        allocations     = 0;
+        VkDeviceSize    requested       = 0;    // Every target with its own memory
+        VkDeviceSize    allocated       = 0;    // After aliasing, lazily allocated memory included
+        VkDeviceSize    lazy            = 0;    // Size of the lazily allocated memory
+        VkDeviceSize    lazyCommitted   = 0;    // What the driver actually backs of it
+    };
+    Footprint   getFootprint() const;
+    void        printReport(std::ostream& out) const;
+
+private:
+    struct Target
+    {
+        RenderTargetDesc    desc;
+        VkImage             image   = nullptr;
+        VkImageView         view    = nullptr;
+        VkDeviceSize        size    = 0;
+        uint32_t            slot    = 0;
+        bool                lazy    = false;
+    };
+
+    // One allocation, shared by the targets bound to it
+    struct Slot
+    {
+        VkDeviceMemory  memory      = nullptr;
+        VkDeviceSize    size        = 0;
+        VkDeviceSize    alignment   = 1;
+        uint32_t        typeBits    = ~0u;
+        bool            lazy        = false;
+        std::vector<RenderTargetHandle> users;
+    };
+
+    bool transient(const RenderTargetDesc& desc) const;
+
+    VkDevice            device = nullptr;
+    std::vector<Target> targets;
+    std::vector<Slot>   slots;
+};
@@ -0,0 +1,227 @@
+#include "ResourceTracker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+static std::mutex                                      objectMutex;
+static std::map<VkObjectType, int64_t>                 objects;
+static std::unordered_map<VkDeviceMemory, VkDeviceSize> deviceMemory;
+static int64_t                                         deviceBytes = 0;
+
+// The host callbacks run on any thread the driver likes, often inside a create of another thread
+static std::atomic<int64_t> hostBytes{ 0 };
+static std::atomic<int64_t> hostAllocations{ 0 };
+static std::atomic<int64_t> hostPeakBytes{ 0 };
+static std::atomic<int64_t> internalBytes{ 0 };
+
+#pragma region HOST ALLOCATION CALLBACKS
+
+// Stored right before the pointer handed to the driver, the size is needed on free and realloc
+struct HostHeader
+{
+    size_t size;
+    size_t offset;  // From the start of the real allocation
+};
+
+static void* alignedAlloc(size_t alignment, size_t size)
+{
+#ifdef _WIN32
+    return _aligned_malloc(size, alignment);
+#else
+    return std::aligned_alloc(alignment, size);
+#endif
+}
+
+static void alignedFree(void* ptr)
+{
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+}
+
+static void* VKAPI_PTR hostAllocate(void*, size_t size, size_t alignment, VkSystemAllocationScope)
+{
+    if (size == 0)
+        return nullptr;
+
+    // The header fills a whole alignment unit, so the pointer after it keeps the alignment asked for
+    alignment     = std::max(alignment, alignof(HostHeader));
+    size_t offset = (sizeof(HostHeader) + alignment - 1) & ~(alignment - 1);
+    size_t total  = (offset + size + alignment - 1) & ~(alignment - 1);
+
+    auto* base = static_cast<uint8_t*>(alignedAlloc(alignment, total));
+    if (!base)
+        return nullptr;
+
+    uint8_t* ptr = base + offset;
+    reinterpret_cast<HostHeader*>(ptr)[-1] = { size, offset };
+
+    int64_t live = hostBytes += static_cast<int64_t>(size);
+    hostAllocations++;
+
+    int64_t peak = hostPeakBytes.load();
+    while (live > peak && !hostPeakBytes.compare_exchange_weak(peak, live)) {}
+
+    return ptr;
+}
+
+static void VKAPI_PTR hostFree(void*, void* ptr)
+{
+    if (!ptr)
+        return;
+
+    HostHeader header = static_cast<HostHeader*>(ptr)[-1];
+    hostBytes -= static_cast<int64_t>(header.size);
+    hostAllocations--;
+
+    alignedFree(static_cast<uint8_t*>(ptr) - header.offset);
+}
+
+static void* VKAPI_PTR hostReallocate(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+    if (!original)
+        return hostAllocate(userData, size, alignment, scope);
+
+    if (size == 0)
+    {
+        hostFree(userData, original);
+        return nullptr;
+    }
+
+    // The original is left untouched when the new allocation fails, as the spec asks
+    void* ptr = hostAllocate(userData, size, alignment, scope);
+    if (!ptr)
+        return nullptr;
+
+    std::memcpy(ptr, original, std::min(size, static_cast<HostHeader*>(original)[-1].size));
+    hostFree(userData, original);
+    return ptr;
+}
+
+static void VKAPI_PTR internalAllocation(void*, size_t size, VkInternalAllocationType, VkSystemAllocationScope)
+{
+    internalBytes += static_cast<int64_t>(size);
+}
+
+static void VKAPI_PTR internalFree(void*, size_t size, VkInternalAllocationType, VkSystemAllocationScope)
+{
+    internalBytes -= static_cast<int64_t>(size);
+}
+
+#pragma endregion
+
+const VkAllocationCallbacks* ResourceTracker::allocator()
+{
+    static const VkAllocationCallbacks callbacks{ nullptr, hostAllocate, hostReallocate, hostFree, internalAllocation, internalFree };
+    return &callbacks;
+}
+
+void ResourceTracker::created(VkObjectType type)
+{
+    std::lock_guard lock(objectMutex);
+    objects[type]++;
+}
+
+void ResourceTracker::destroyed(VkObjectType type)
+{
+    std::lock_guard lock(objectMutex);
+    objects[type]--;
+}
+
+void ResourceTracker::allocated(VkDeviceMemory memory, VkDeviceSize size)
+{
+    if (memory == VK_NULL_HANDLE)
+        return;
+
+    std::lock_guard lock(objectMutex);
+    objects[VK_OBJECT_TYPE_DEVICE_MEMORY]++;
+    deviceMemory[memory] = size;
+    deviceBytes += static_cast<int64_t>(size);
+}
+
+void ResourceTracker::freed(VkDeviceMemory memory)
+{
+    if (memory == VK_NULL_HANDLE)
+        return;
+
+    std::lock_guard lock(objectMutex);
+    auto it = deviceMemory.find(memory);
+    if (it == deviceMemory.end())
+        return;
+
+    objects[VK_OBJECT_TYPE_DEVICE_MEMORY]--;
+    deviceBytes -= static_cast<int64_t>(it->second);
+    deviceMemory.erase(it);
+}
+
+int64_t ResourceTracker::Counts::liveObjects() const
+{
+    int64_t total = 0;
+    for (const auto& [type, count] : objects)
+        total += count;
+    return total;
+}
+
+ResourceTracker::Counts ResourceTracker::snapshot()
+{
+    Counts counts;
+    {
+        std::lock_guard lock(objectMutex);
+        counts.objects           = objects;
+        counts.deviceBytes       = deviceBytes;
+        counts.deviceAllocations = static_cast<int64_t>(deviceMemory.size());
+    }
+
+    counts.hostBytes       = hostBytes;
+    counts.hostAllocations = hostAllocations;
+    counts.hostPeakBytes   = hostPeakBytes;
+    counts.internalBytes   = internalBytes;
+    return counts;
+}
+
+const char* ResourceTracker::objectTypeName(VkObjectType type)
+{
+    switch (type)
+    {
+    case VK_OBJECT_TYPE_INSTANCE:                   return "instance";
+    case VK_OBJECT_TYPE_DEVICE:                     return "device";
+    case VK_OBJECT_TYPE_SURFACE_KHR:                return "surface";
+    case VK_OBJECT_TYPE_SWAPCHAIN_KHR:              return "swap chain";
+    case VK_OBJECT_TYPE_DEBUG_UTILS_MESSENGER_EXT:  return "debug messenger";
+    case VK_OBJECT_TYPE_DEVICE_MEMORY:              return "device memory";
+    case VK_OBJECT_TYPE_BUFFER:                     return "buffer";
+    case VK_OBJECT_TYPE_IMAGE:                      return "image";
+    case VK_OBJECT_TYPE_IMAGE_VIEW:                 return "image view";
+    case VK_OBJECT_TYPE_SHADER_MODULE:              return "shader module";
+    case VK_OBJECT_TYPE_PIPELINE_LAYOUT:            return "pipeline layout";
+    case VK_OBJECT_TYPE_PIPELINE:                   return "pipeline";
+    case VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT:      return "descriptor set layout";
+    case VK_OBJECT_TYPE_DESCRIPTOR_POOL:            return "descriptor pool";
+    case VK_OBJECT_TYPE_COMMAND_POOL:               return "command pool";
+    case VK_OBJECT_TYPE_FENCE:                      return "fence";
+    case VK_OBJECT_TYPE_SEMAPHORE:                  return "semaphore";
+    case VK_OBJECT_TYPE_QUERY_POOL:                 return "query pool";
+    default:                                        return "other";
+    }
+}
+
+void ResourceTracker::printReport(std::ostream& out, const Counts& counts, bool all)
+{
+    auto kib = [](int64_t bytes) { return static_cast<double>(bytes) / 1024.0; };
+
+    out << "  " << counts.liveObjects() << " live objects, device memory " << kib(counts.deviceBytes) << " KiB in "
+        << counts.deviceAllocations << " allocations, host " << kib(counts.hostBytes) << " KiB in " << counts.hostAllocations
+        << " allocations (peak " << kib(counts.hostPeakBytes) << " KiB, driver internal " << kib(counts.internalBytes) << " KiB)" << std::endl;
+
+    for (const auto& [type, count] : counts.objects)
+    {
+        if (count != 0 || all)
+            out << "    " << objectTypeName(type) << ": " << count << std::endl;
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+
+// Live Vulkan objects of the process, by type, the device memory they hold and the host memory
+// the driver and layers allocate for them. Every create/destroy of the engine goes through it
+// and hands allocator() to Vulkan, so a leak shows up as a count that never comes back down.
+// Process wide, like AllocationCounter: the render farm devices add up
+namespace ResourceTracker
+{
+    struct Counts
+    {
+        std::map<VkObjectType, int64_t> objects;    // Live objects by type, types that dropped back to 0 are kept
+
+        int64_t deviceBytes       = 0;  // vkAllocateMemory sizes not freed yet
+        int64_t deviceAllocations = 0;
+        int64_t hostBytes         = 0;  // Through allocator(), the driver internal allocations are apart
+        int64_t hostAllocations   = 0;
+        int64_t hostPeakBytes     = 0;
+        int64_t internalBytes     = 0;  // What the driver reports allocating on its own
+
+        int64_t liveObjects() const;
+    };
+
+    // Host allocation callbacks to pass as pAllocator of every create, and the matching destroy
+    const VkAllocationCallbacks* allocator();
+
+    // Called after a create and before a destroy. Null handles are ignored, so cleanup can
+    // report whatever it destroys without checking what was created
+    void created(VkObjectType type);
+    void destroyed(VkObjectType type);
+
+    template <typename Handle>
+    void created(VkObjectType type, Handle handle)
+    {
+        if (handle != VK_NULL_HANDLE)
+            created(type);
+    }
+
+    template <typename Handle>
+    void destroyed(VkObjectType type, Handle handle)
+    {
+        if (handle != VK_NULL_HANDLE)
+            destroyed(type);
+    }
+
+    // vkAllocateMemory/vkFreeMemory, the size is looked up on free
+    void allocated(VkDeviceMemory memory, VkDeviceSize size);
+    void freed(VkDeviceMemory memory);
+
+    Counts snapshot();
+
+    const char* objectTypeName(VkObjectType type);
+
+    // Live objects by type and memory, only the types that have some unless all is set
+    void printReport(std::ostream& out, const Counts& counts, bool all = false);
+}
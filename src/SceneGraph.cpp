@@ -0,0 +1,272 @@
+#include "SceneGraph.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+// Nodes per task, small enough to balance the threads, big enough to amortize the scheduling
+constexpr uint32_t TASK_GRAIN = 2048;
+
+SceneGraph::SceneGraph(unsigned threadCount)
+{
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    for (unsigned i = 1; i < threadCount; i++)
+        threads.emplace_back(&SceneGraph::workerLoop, this);
+}
+
+SceneGraph::~SceneGraph()
+{
+    {
+        std::lock_guard lock(mutex);
+        quit = true;
+    }
+    wakeCv.notify_all();
+
+    for (auto& thread : threads)
+        thread.join();
+}
+
+void SceneGraph::reserve(size_t count)
+{
+    parent.reserve(count);
+    subtreeEnd.reserve(count);
+    translation.reserve(count);
+    rotation.reserve(count);
+    scale.reserve(count);
+    world.reserve(count);
+    lod.reserve(count);
+    dirty.reserve(count);
+    for (auto* component : { &localX, &localY, &localZ, &localR, &worldX, &worldY, &worldZ, &worldR })
+        component->reserve(count);
+}
+
+uint32_t SceneGraph::addNode(uint32_t parent_, const glm::vec3& translation_, const glm::quat& rotation_, const glm::vec3& scale_,
+    const glm::vec4& localSphere)
+{
+    // Back to the parent on the current path, anything else would break the contiguous subtrees
+    while (!path.empty() && path.back() != parent_)
+        path.pop_back();
+    if (parent_ != NO_PARENT && path.empty())
+        throw std::runtime_error("scene graph: nodes have to be added depth first");
+
+    uint32_t node = static_cast<uint32_t>(parent.size());
+    path.push_back(node);
+
+    parent.push_back(parent_);
+    subtreeEnd.push_back(node + 1);
+    for (size_t i = 0; i + 1 < path.size(); i++)
+        subtreeEnd[path[i]] = node + 1;
+
+    translation.push_back(translation_);
+    rotation.push_back(rotation_);
+    scale.push_back(scale_);
+
+    localX.push_back(localSphere.x);
+    localY.push_back(localSphere.y);
+    localZ.push_back(localSphere.z);
+    localR.push_back(localSphere.w);
+
+    world.emplace_back(1.f);
+    for (auto* component : { &worldX, &worldY, &worldZ, &worldR })
+        component->push_back(0.f);
+    lod.push_back(0);
+
+    dirty.push_back(0);
+    markDirty(node);
+
+    return node;
+}
+
+void SceneGraph::markDirty(uint32_t node)
+{
+    if (dirty[node])
+        return;
+
+    dirty[node] = 1;
+    dirtyNodes.push_back(node);
+}
+
+void SceneGraph::setLocal(uint32_t node, const glm::vec3& translation_, const glm::quat& rotation_, const glm::vec3& scale_)
+{
+    translation[node]   = translation_;
+    rotation[node]      = rotation_;
+    scale[node]         = scale_;
+    markDirty(node);
+}
+
+void SceneGraph::setTranslation(uint32_t node, const glm::vec3& translation_)
+{
+    translation[node] = translation_;
+    markDirty(node);
+}
+
+void SceneGraph::updateNode(uint32_t node)
+{
+    // Local = T * R * S, built in place
+    glm::mat4 local = glm::mat4_cast(rotation[node]);
+    local[0] *= scale[node].x;
+    local[1] *= scale[node].y;
+    local[2] *= scale[node].z;
+    local[3]  = glm::vec4(translation[node], 1.f);
+
+    uint32_t p = parent[node];
+    glm::aligned_mat4 m = p == NO_PARENT ? glm::aligned_mat4(local) : world[p] * glm::aligned_mat4(local);
+    world[node] = m;
+
+    glm::aligned_vec4 center = m * glm::aligned_vec4(localX[node], localY[node], localZ[node], 1.f);
+    float maxScale = std::sqrt(std::max({ glm::dot(m[0], m[0]), glm::dot(m[1], m[1]), glm::dot(m[2], m[2]) }));
+
+    worldX[node] = center.x;
+    worldY[node] = center.y;
+    worldZ[node] = center.z;
+    worldR[node] = localR[node] * maxScale;
+
+    if (output)
+    {
+        SceneInstance& instance = output[node];
+        instance.world  = glm::mat4(m);
+        instance.sphere = glm::vec4(center.x, center.y, center.z, worldR[node]);
+        instance.lod    = lod[node];
+    }
+}
+
+void SceneGraph::updateRange(const Range& range)
+{
+    // Depth first: the parent of every node is either before it in the range or already done
+    for (uint32_t node = range.begin; node < range.end; node++)
+        updateNode(node);
+}
+
+void SceneGraph::split(uint32_t node, uint32_t end)
+{
+    // Small enough, or appended to the previous task if it's its sibling (contiguous)
+    if (end - node <= TASK_GRAIN)
+    {
+        if (!tasks.empty() && tasks.back().end == node && end - tasks.back().begin <= TASK_GRAIN)
+            tasks.back().end = end;
+        else
+            tasks.push_back({ node, end });
+        return;
+    }
+
+    // The head of a big subtree is done right away, its children become independent
+    updateNode(node);
+    for (uint32_t child = node + 1; child < end; child = subtreeEnd[child])
+        split(child, subtreeEnd[child]);
+}
+
+size_t SceneGraph::update(SceneInstance* instances)
+{
+    if (dirtyNodes.empty())
+        return 0;
+
+    output = instances;
+    tasks.clear();
+
+    // A dirty node inside the subtree of an earlier dirty node is already covered
+    std::sort(dirtyNodes.begin(), dirtyNodes.end());
+    size_t   updated = 0;
+    uint32_t covered = 0;
+    for (uint32_t node : dirtyNodes)
+    {
+        dirty[node] = 0;
+        if (node < covered)
+            continue;
+
+        covered  = subtreeEnd[node];
+        updated += covered - node;
+        split(node, covered);
+    }
+    dirtyNodes.clear();
+
+    runTasks();
+    output = nullptr;
+
+    return updated;
+}
+
+void SceneGraph::runTasks()
+{
+    nextTask.store(0, std::memory_order_relaxed);
+
+    if (threads.empty() || tasks.size() < 2)
+    {
+        work();
+        return;
+    }
+
+    {
+        std::lock_guard lock(mutex);
+        generation++;
+        running = static_cast<unsigned>(threads.size());
+    }
+    wakeCv.notify_all();
+
+    work();
+
+    std::unique_lock lock(mutex);
+    doneCv.wait(lock, [&]() { return running == 0; });
+}
+
+void SceneGraph::work()
+{
+    for (size_t t = nextTask.fetch_add(1, std::memory_order_relaxed); t < tasks.size(); t = nextTask.fetch_add(1, std::memory_order_relaxed))
+        updateRange(tasks[t]);
+}
+
+void SceneGraph::workerLoop()
+{
+    uint64_t seen = 0;
+    while (true)
+    {
+        {
+            std::unique_lock lock(mutex);
+            wakeCv.wait(lock, [&]() { return quit || generation != seen; });
+            if (quit)
+                return;
+            seen = generation;
+        }
+
+        work();
+
+        std::lock_guard lock(mutex);
+        if (--running == 0)
+            doneCv.notify_one();
+    }
+}
+
+void SceneGraph::updateLods(const glm::vec3& camera, const float* thresholds, uint32_t thresholdCount, SceneInstance* instances)
+{
+    thresholdCount = std::min(thresholdCount, SCENE_MAX_LODS);
+
+    // Compared squared, no sqrt nor division in the loop, which the compiler vectorizes
+    float squared[SCENE_MAX_LODS]{};
+    for (uint32_t i = 0; i < thresholdCount; i++)
+        squared[i] = thresholds[i] * thresholds[i];
+
+    const size_t count = size();
+    const float* x = worldX.data();
+    const float* y = worldY.data();
+    const float* z = worldZ.data();
+    const float* r = worldR.data();
+    uint8_t*     l = lod.data();
+
+    for (size_t i = 0; i < count; i++)
+    {
+        float dx = x[i] - camera.x;
+        float dy = y[i] - camera.y;
+        float dz = z[i] - camera.z;
+        float d2 = std::max(dx * dx + dy * dy + dz * dz, 1e-6f);
+        float r2 = r[i] * r[i];
+
+        uint8_t level = 0;
+        for (uint32_t k = 0; k < thresholdCount; k++)
+            level += r2 < squared[k] * d2 ? 1 : 0;
+
+        if (level != l[i] && instances)
+            instances[i].lod = level;
+        l[i] = level;
+    }
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_aligned.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+constexpr uint32_t NO_PARENT      = ~0u;
+constexpr uint32_t SCENE_MAX_LODS = 4;
+
+// What the GPU reads for one node (std430 friendly)
+struct SceneInstance
+{
+    glm::mat4   world;
+    glm::vec4   sphere;     // World bounding sphere, xyz = center, w = radius
+    uint32_t    lod;
+    uint32_t    pad[3];
+};
+
+// Transform hierarchy in structure of arrays: every field of the nodes is its own array, so a pass
+// only streams through the data it uses. Nodes are stored depth first, a subtree is the contiguous
+// range [node, subtreeEnd[node]) and a parent always comes before its children.
+// update() only recomputes the subtrees of the nodes changed since the last one, spread over worker
+// threads, and writes the results straight into the (GPU visible) instance array.
+// World matrices use glm's aligned types, which go through SIMD with GLM_FORCE_INTRINSICS
+class SceneGraph
+{
+public:
+    // 0 threads = one per core, the calling thread included
+    explicit SceneGraph(unsigned threadCount = 0);
+    ~SceneGraph();
+
+    SceneGraph(const SceneGraph&)            = delete;
+    SceneGraph& operator=(const SceneGraph&) = delete;
+
+    void reserve(size_t count);
+
+    // Nodes are added depth first: the parent is NO_PARENT, the last added node or one of its ancestors
+    uint32_t addNode(uint32_t parent, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale,
+        const glm::vec4& localSphere);
+
+    void setLocal(uint32_t node, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale);
+    void setTranslation(uint32_t node, const glm::vec3& translation);
+
+    // Recomputes the world transforms and bounds of the dirty subtrees, instances (one per node) may be null.
+    // Returns the number of nodes updated
+    size_t update(SceneInstance* instances);
+
+    // LOD of every node from its projected size: lod = how many thresholds (radius / distance, decreasing)
+    // the node is under. Only the changed LODs are written to instances
+    void updateLods(const glm::vec3& camera, const float* thresholds, uint32_t thresholdCount, SceneInstance* instances);
+
+    size_t                      size() const { return parent.size(); }
+    uint32_t                    getParent(uint32_t node) const { return parent[node]; }
+    uint32_t                    getSubtreeEnd(uint32_t node) const { return subtreeEnd[node]; }
+    const glm::aligned_mat4&    getWorld(uint32_t node) const { return world[node]; }
+    uint32_t                    getLod(uint32_t node) const { return lod[node]; }
+    unsigned                    getThreadCount() const { return static_cast<unsigned>(threads.size()) + 1; }
+
+private:
+    struct Range
+    {
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    void markDirty(uint32_t node);
+    void updateNode(uint32_t node);
+    void updateRange(const Range& range);
+    void split(uint32_t node, uint32_t end);
+    void runTasks();
+    void workerLoop();
+    void work();
+
+    // Hierarchy
+    std::vector<uint32_t> parent;
+    std::vector<uint32_t> subtreeEnd;
+    std::vector<uint32_t> path;     // Last added node and its ancestors, for the depth first check
+
+    // Local transforms
+    std::vector<glm::vec3> translation;
+    std::vector<glm::quat> rotation;
+    std::vector<glm::vec3> scale;
+
+    // Local bounding spheres, one array per component
+    std::vector<float> localX, localY, localZ, localR;
+
+    // Results
+    std::vector<glm::aligned_mat4>  world;
+    std::vector<float>              worldX, worldY, worldZ, worldR;
+    std::vector<uint8_t>            lod;
+
+    std::vector<uint8_t>    dirty;
+    std::vector<uint32_t>   dirtyNodes;
+
+    // Work of the current update, reused between updates
+    std::vector<Range>      tasks;
+    SceneInstance*          output = nullptr;
+    std::atomic<size_t>     nextTask{ 0 };
+
+    std::vector<std::thread>    threads;
+    std::mutex                  mutex;
+    std::condition_variable     wakeCv;
+    std::condition_variable     doneCv;
+    uint64_t                    generation  = 0;
+    unsigned                    running     = 0;
+    bool                        quit        = false;
+};
@@ -0,0 +1,156 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Shader features are boolean specialization constants: there is one SPIR-V per shader, and the
+// driver drops the code of the disabled features when it compiles a pipeline for a variant.
+// A shader is described here by its features, each pipeline that uses it by the features it
+// accepts, so the permutations that can be built are known at compile time
+
+struct ShaderFeature
+{
+    const char* name;
+    uint32_t    constantId;     // constant_id in the shader
+};
+
+// data/shaders/shader.frag
+struct FragShader
+{
+    // Bit i is features[i]
+    enum Feature : uint32_t
+    {
+        Lighting    = 1u << 0,  // The color is an encoded normal, lit by a directional light
+        Dither      = 1u << 1,  // Ordered dithering of the 8 bit output
+    };
+
+    static constexpr std::array<ShaderFeature, 2> features = { {
+        { "lighting",   0 },
+        { "dither",     1 },
+    } };
+};
+
+// Features a pipeline accepts, the others are masked out when picking its variant
+template <typename Shader, uint32_t Allowed>
+struct PipelineVariants
+{
+    static_assert((Allowed >> Shader::features.size()) == 0, "the shader doesn't have the feature");
+
+    static constexpr uint32_t allowed = Allowed;
+    static constexpr uint32_t count   = 1u << std::popcount(Allowed);
+
+    static constexpr uint32_t select(uint32_t features) { return features & Allowed; }
+};
+
+// The triangle's colors aren't normals, it can't be lit
+using TriangleVariants  = PipelineVariants<FragShader, FragShader::Dither>;
+using SceneVariants     = PipelineVariants<FragShader, FragShader::Lighting | FragShader::Dither>;
+
+// Pipelines of every variant of a shader, indexed by the feature mask. Null until compiled
+template <typename Shader>
+using VariantTable = std::array<VkPipeline, 1u << Shader::features.size()>;
+
+// Specialization constants of a variant, one VkBool32 per feature of the shader
+template <typename Shader>
+class Specialization
+{
+public:
+    constexpr explicit Specialization(uint32_t features)
+    {
+        for (uint32_t i = 0; i < Shader::features.size(); i++)
+        {
+            entries[i].constantID   = Shader::features[i].constantId;
+            entries[i].offset       = i * sizeof(VkBool32);
+            entries[i].size         = sizeof(VkBool32);
+            values[i]               = (features >> i) & 1u;
+        }
+    }
+
+    // Points into this object, it has to outlive the pipeline creation
+    VkSpecializationInfo info() const
+    {
+        return { static_cast<uint32_t>(entries.size()), entries.data(), sizeof(values), values.data() };
+    }
+
+private:
+    std::array<VkSpecializationMapEntry, Shader::features.size()>   entries{};
+    std::array<VkBool32, Shader::features.size()>                   values{};
+};
+
+// True if the SPIR-V declares every feature of the shader as a specialization constant
+// (OpDecorate SpecId). The map entries of a module built from an older source would be
+// ignored without a word from the driver, and every variant would render the base shader
+template <typename Shader>
+bool declaresFeatures(const uint32_t* words, size_t wordCount)
+{
+    constexpr uint32_t OP_DECORATE        = 71;
+    constexpr uint32_t DECORATION_SPEC_ID = 1;
+
+    uint32_t found = 0;
+    for (size_t i = 5; i < wordCount; )     // After the header
+    {
+        uint32_t length = words[i] >> 16;
+        if (length == 0 || i + length > wordCount)
+            return false;
+
+        if ((words[i] & 0xFFFFu) == OP_DECORATE && length == 4 && words[i + 2] == DECORATION_SPEC_ID)
+        {
+            for (uint32_t f = 0; f < Shader::features.size(); f++)
+            {
+                if (Shader::features[f].constantId == words[i + 3])
+                    found |= 1u << f;
+            }
+        }
+        i += length;
+    }
+    return found == (1u << Shader::features.size()) - 1;
+}
+
+// "lighting+dither", or "base" without any feature
+template <typename Shader>
+std::string variantName(uint32_t features)
+{
+    std::string name;
+    for (uint32_t i = 0; i < Shader::features.size(); i++)
+    {
+        if (features & (1u << i))
+            name += (name.empty() ? "" : "+") + std::string(Shader::features[i].name);
+    }
+    return name.empty() ? "base" : name;
+}
+
+// Mask of the features named in a comma separated list. False if a name isn't a feature of the shader
+template <typename Shader>
+bool parseFeatures(const std::string& list, uint32_t& features)
+{
+    features = 0;
+    size_t start = 0;
+    while (start <= list.size())
+    {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos)
+            end = list.size();
+
+        std::string name = list.substr(start, end - start);
+        bool found = name.empty();
+        for (uint32_t i = 0; i < Shader::features.size() && !found; i++)
+        {
+            if (name == Shader::features[i].name)
+            {
+                features |= 1u << i;
+                found = true;
+            }
+        }
+        if (!found)
+            return false;
+
+        start = end + 1;
+    }
+    return true;
+}
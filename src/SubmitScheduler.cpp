@@ -0,0 +1,237 @@
+#include "SubmitScheduler.h"
+#include "Trace.h"
+
+#include <stdexcept>
+
+SubmitScheduler::SubmitScheduler()
+{
+    // Enough for several views and producers, clear() keeps the capacity between frames
+    const size_t reserved = 32;
+    for (auto* infos : { &cmdInfos, &mergedCmds })
+        infos->reserve(reserved);
+    for (auto* infos : { &waitInfos, &signalInfos, &mergedWaits, &mergedSignals })
+        infos->reserve(reserved);
+
+    batches.reserve(reserved);
+    presents.reserve(reserved);
+    fences.reserve(4);
+    submitInfos.reserve(reserved);
+    queues.reserve(4);
+    presentSwapChains.reserve(reserved);
+    presentIndices.reserve(reserved);
+    presentWaits.reserve(reserved);
+}
+
+void SubmitScheduler::submit(VkQueue queue, SubmitProducer producer,
+    const VkCommandBuffer* cmds, uint32_t cmdCount,
+    const VkSemaphoreSubmitInfo* waits, uint32_t waitCount,
+    const VkSemaphoreSubmitInfo* signals, uint32_t signalCount)
+{
+    Batch batch{};
+    batch.queue         = queue;
+    batch.producer      = producer;
+    batch.firstCmd      = static_cast<uint32_t>(cmdInfos.size());
+    batch.cmdCount      = cmdCount;
+    batch.firstWait     = static_cast<uint32_t>(waitInfos.size());
+    batch.waitCount     = waitCount;
+    batch.firstSignal   = static_cast<uint32_t>(signalInfos.size());
+    batch.signalCount   = signalCount;
+    batches.push_back(batch);
+
+    for (uint32_t i = 0; i < cmdCount; i++)
+    {
+        VkCommandBufferSubmitInfo cmdInfo{};
+        cmdInfo.sType           = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+        cmdInfo.commandBuffer   = cmds[i];
+        cmdInfos.push_back(cmdInfo);
+    }
+    waitInfos.insert(waitInfos.end(), waits, waits + waitCount);
+    signalInfos.insert(signalInfos.end(), signals, signals + signalCount);
+}
+
+void SubmitScheduler::present(VkQueue queue, VkSwapchainKHR swapChain, uint32_t imageIndex, VkSemaphore wait)
+{
+    presents.push_back({ queue, swapChain, imageIndex, wait });
+}
+
+void SubmitScheduler::setFence(VkQueue queue, VkFence fence)
+{
+    for (auto& queueFence : fences)
+    {
+        if (queueFence.queue == queue)
+        {
+            queueFence.fence = fence;
+            return;
+        }
+    }
+    fences.push_back({ queue, fence });
+}
+
+VkFence SubmitScheduler::fenceOf(VkQueue queue) const
+{
+    for (const auto& queueFence : fences)
+    {
+        if (queueFence.queue == queue)
+            return queueFence.fence;
+    }
+    return VK_NULL_HANDLE;
+}
+
+void SubmitScheduler::flushQueue(VkQueue queue)
+{
+    submitInfos.clear();
+    mergedCmds.clear();
+    mergedWaits.clear();
+    mergedSignals.clear();
+
+    // The merged arrays must not reallocate while the submit infos point into them
+    mergedCmds.reserve(cmdInfos.size());
+    mergedWaits.reserve(waitInfos.size());
+    mergedSignals.reserve(signalInfos.size());
+    submitInfos.reserve(batches.size());
+
+    // Ranges of the submit infos in the merged arrays, pointers are patched at the end
+    struct Range { uint32_t firstCmd, cmdCount, firstWait, waitCount, firstSignal, signalCount; };
+    Range  current{};
+    bool   open = false;
+
+    auto close = [&]()
+    {
+        if (!open)
+            return;
+
+        VkSubmitInfo2 info{};
+        info.sType                      = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+        info.commandBufferInfoCount     = current.cmdCount;
+        info.pCommandBufferInfos        = mergedCmds.data() + current.firstCmd;
+        info.waitSemaphoreInfoCount     = current.waitCount;
+        info.pWaitSemaphoreInfos        = mergedWaits.data() + current.firstWait;
+        info.signalSemaphoreInfoCount   = current.signalCount;
+        info.pSignalSemaphoreInfos      = mergedSignals.data() + current.firstSignal;
+        submitInfos.push_back(info);
+        open = false;
+    };
+
+    for (uint32_t p = 0; p < static_cast<uint32_t>(SubmitProducer::Count); p++)
+    {
+        for (const auto& batch : batches)
+        {
+            if (batch.queue != queue || static_cast<uint32_t>(batch.producer) != p)
+                continue;
+
+            stats.batches++;
+
+            // Appending to the open submit info is only free if no wait gets imposed on the
+            // new command buffers and no signal gets delayed by them
+            bool merge = open && batch.waitCount == 0 && current.waitCount == 0 && current.signalCount == 0;
+            if (!merge)
+            {
+                close();
+                current.firstCmd    = static_cast<uint32_t>(mergedCmds.size());
+                current.firstWait   = static_cast<uint32_t>(mergedWaits.size());
+                current.firstSignal = static_cast<uint32_t>(mergedSignals.size());
+                current.cmdCount    = 0;
+                current.waitCount   = 0;
+                current.signalCount = 0;
+                open = true;
+            }
+
+            mergedCmds.insert(mergedCmds.end(), cmdInfos.begin() + batch.firstCmd, cmdInfos.begin() + batch.firstCmd + batch.cmdCount);
+            mergedWaits.insert(mergedWaits.end(), waitInfos.begin() + batch.firstWait, waitInfos.begin() + batch.firstWait + batch.waitCount);
+            mergedSignals.insert(mergedSignals.end(), signalInfos.begin() + batch.firstSignal, signalInfos.begin() + batch.firstSignal + batch.signalCount);
+            current.cmdCount    += batch.cmdCount;
+            current.waitCount   += batch.waitCount;
+            current.signalCount += batch.signalCount;
+        }
+    }
+    close();
+
+    VkFence fence = fenceOf(queue);
+    if (submitInfos.empty() && !fence)
+        return;
+
+    // An empty submit still signals the fence, callers rely on it to pace the frames
+    TRACE_SCOPE("vkQueueSubmit2", "submit", submitInfos.size());
+    if (vkQueueSubmit2(queue, static_cast<uint32_t>(submitInfos.size()), submitInfos.data(), fence) != VK_SUCCESS)
+        throw std::runtime_error("Could not submit the frame");
+
+    stats.submitCalls++;
+    stats.submitInfos += submitInfos.size();
+}
+
+VkResult SubmitScheduler::flush()
+{
+    stats.flushes++;
+
+    // Every queue that got a batch or a fence, in first use order
+    queues.clear();
+    auto addQueue = [&](VkQueue queue)
+    {
+        for (VkQueue known : queues)
+        {
+            if (known == queue)
+                return;
+        }
+        queues.push_back(queue);
+    };
+    for (const auto& batch : batches)
+        addQueue(batch.queue);
+    for (const auto& queueFence : fences)
+    {
+        if (queueFence.fence)
+            addQueue(queueFence.queue);
+    }
+
+    for (VkQueue queue : queues)
+        flushQueue(queue);
+
+    batches.clear();
+    cmdInfos.clear();
+    waitInfos.clear();
+    signalInfos.clear();
+    for (auto& queueFence : fences)
+        queueFence.fence = VK_NULL_HANDLE;
+
+    // One present per queue for all of its swap chains
+    VkResult worst = VK_SUCCESS;
+    queues.clear();
+    for (const auto& present : presents)
+        addQueue(present.queue);
+
+    for (VkQueue queue : queues)
+    {
+        presentSwapChains.clear();
+        presentIndices.clear();
+        presentWaits.clear();
+        for (const auto& present : presents)
+        {
+            if (present.queue != queue)
+                continue;
+
+            presentSwapChains.push_back(present.swapChain);
+            presentIndices.push_back(present.imageIndex);
+            if (present.wait)
+                presentWaits.push_back(present.wait);
+        }
+
+        VkPresentInfoKHR presentInfo{};
+        presentInfo.sType               = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        presentInfo.waitSemaphoreCount  = static_cast<uint32_t>(presentWaits.size());
+        presentInfo.pWaitSemaphores     = presentWaits.data();
+        presentInfo.swapchainCount      = static_cast<uint32_t>(presentSwapChains.size());
+        presentInfo.pSwapchains         = presentSwapChains.data();
+        presentInfo.pImageIndices       = presentIndices.data();
+
+        TRACE_SCOPE("vkQueuePresentKHR", "present", presentSwapChains.size());
+        VkResult result = vkQueuePresentKHR(queue, &presentInfo);
+        if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+            throw std::runtime_error("Could not present the image");
+        if (result == VK_SUBOPTIMAL_KHR)
+            worst = result;
+
+        stats.presentCalls++;
+    }
+    presents.clear();
+
+    return worst;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <vector>
+
+// Who produced a batch. Batches are flushed in this order, so uploads land before the
+// compute work that reads them, and compute before the rendering that consumes it
+enum class SubmitProducer : uint32_t
+{
+    Upload,
+    Compute,
+    Render,
+    Count
+};
+
+// Collects the command buffers, semaphore waits/signals and presents of a frame from every
+// producer, and flushes them with one vkQueueSubmit2 and one vkQueuePresentKHR per queue.
+// Consecutive batches are merged into the same VkSubmitInfo2 when it doesn't add a dependency.
+// Storage is reserved up front and reused, a steady state frame doesn't allocate
+class SubmitScheduler
+{
+public:
+    SubmitScheduler();
+
+    // Adds a batch: its command buffers run after the waits, the signals fire once they're done.
+    // The waits/signals are copied, the stage masks should be as tight as possible
+    void submit(VkQueue queue, SubmitProducer producer,
+        const VkCommandBuffer* cmds, uint32_t cmdCount,
+        const VkSemaphoreSubmitInfo* waits = nullptr, uint32_t waitCount = 0,
+        const VkSemaphoreSubmitInfo* signals = nullptr, uint32_t signalCount = 0);
+
+    void present(VkQueue queue, VkSwapchainKHR swapChain, uint32_t imageIndex, VkSemaphore wait);
+
+    // Signaled by the submit of the queue once everything flushed to it is done
+    void setFence(VkQueue queue, VkFence fence);
+
+    // Submits everything, then presents. Returns the worst present result (SUCCESS/SUBOPTIMAL)
+    VkResult flush();
+
+    struct Stats
+    {
+        uint64_t flushes     = 0;
+        uint64_t submitCalls = 0;   // vkQueueSubmit2
+        uint64_t submitInfos = 0;   // VkSubmitInfo2 after merging
+        uint64_t batches     = 0;   // Before merging
+        uint64_t presentCalls = 0;
+    };
+    const Stats& getStats() const { return stats; }
+    void         resetStats() { stats = {}; }
+
+private:
+    struct Batch
+    {
+        VkQueue         queue;
+        SubmitProducer  producer;
+        uint32_t        firstCmd, cmdCount;
+        uint32_t        firstWait, waitCount;
+        uint32_t        firstSignal, signalCount;
+    };
+
+    struct Present
+    {
+        VkQueue         queue;
+        VkSwapchainKHR  swapChain;
+        uint32_t        imageIndex;
+        VkSemaphore     wait;
+    };
+
+    struct QueueFence
+    {
+        VkQueue queue;
+        VkFence fence;
+    };
+
+    VkFence fenceOf(VkQueue queue) const;
+    void    flushQueue(VkQueue queue);
+
+    std::vector<Batch>                      batches;
+    std::vector<VkCommandBufferSubmitInfo>  cmdInfos;
+    std::vector<VkSemaphoreSubmitInfo>      waitInfos;
+    std::vector<VkSemaphoreSubmitInfo>      signalInfos;
+    std::vector<Present>                    presents;
+    std::vector<QueueFence>                 fences;
+
+    // Scratch of flush, built in place for each queue
+    std::vector<VkSubmitInfo2>              submitInfos;
+    std::vector<VkCommandBufferSubmitInfo>  mergedCmds;
+    std::vector<VkSemaphoreSubmitInfo>      mergedWaits;
+    std::vector<VkSemaphoreSubmitInfo>      mergedSignals;
+    std::vector<VkQueue>                    queues;
+    std::vector<VkSwapchainKHR>             presentSwapChains;
+    std::vector<uint32_t>                   presentIndices;
+    std::vector<VkSemaphore>                presentWaits;
+
+    Stats stats;
+};
@@ -0,0 +1,319 @@
+#include "Trace.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+    enum class EventType : uint8_t
+    {
+        Complete,
+        Instant,
+    };
+
+    struct Event
+    {
+        const char* name;
+        const char* category;
+        uint64_t    start;
+        uint64_t    duration;
+        uint64_t    arg;
+        uint32_t    track;      // 0 = the thread that wrote it
+        EventType   type;
+    };
+
+    // ~1.5 MiB per thread, allocated on its first event
+    constexpr uint64_t RING_SIZE = 32 * 1024;
+
+    struct ThreadBuffer
+    {
+        std::array<Event, RING_SIZE>    events;
+        std::atomic<uint64_t>           head{ 0 };  // Written by the owner thread only
+        std::atomic<uint64_t>           tail{ 0 };  // Written by collect only
+        std::atomic<uint64_t>           dropped{ 0 };
+        uint32_t                        tid = 0;
+    };
+
+    struct CollectedEvent
+    {
+        Event       event;
+        uint32_t    tid;
+    };
+
+    // ~14 MiB of collected events, minutes of frames. Past it the oldest ones go, so a trace left on
+    // for days ends with the last part of the run instead of growing until the process runs out
+    constexpr size_t MAX_COLLECTED = 256 * 1024;
+
+    struct Track
+    {
+        uint32_t    tid;
+        std::string name;
+    };
+
+    // Everything below is only touched under the mutex, outside of the hot path
+    struct Registry
+    {
+        std::mutex                                  mutex;
+        std::vector<std::unique_ptr<ThreadBuffer>>  buffers;
+        std::vector<Track>                          names;      // Threads and tracks
+        std::deque<CollectedEvent>                  collected;  // Oldest first, at most MAX_COLLECTED
+        uint64_t                                    discarded = 0;
+        uint32_t                                    nextTid   = 1;
+        uint32_t                                    nextTrack = 1u << 16;   // Away from the thread ids
+    };
+
+    Registry& registry()
+    {
+        static Registry instance;
+        return instance;
+    }
+
+    std::atomic<bool> enabled{ false };
+
+    const auto epoch = std::chrono::steady_clock::now();
+
+    thread_local uint32_t       localTid    = 0;
+    thread_local ThreadBuffer*  localBuffer = nullptr;
+
+    uint32_t threadId()
+    {
+        if (!localTid)
+        {
+            Registry& reg = registry();
+            std::lock_guard lock(reg.mutex);
+            localTid = reg.nextTid++;
+        }
+
+        return localTid;
+    }
+
+    // Naming a thread doesn't allocate its ring, only its first event does
+    ThreadBuffer& threadBuffer()
+    {
+        if (!localBuffer)
+        {
+            auto buffer = std::make_unique<ThreadBuffer>();
+            buffer->tid = threadId();
+
+            Registry& reg = registry();
+            std::lock_guard lock(reg.mutex);
+            localBuffer = buffer.get();
+            reg.buffers.push_back(std::move(buffer));
+        }
+
+        return *localBuffer;
+    }
+
+    void push(const Event& event)
+    {
+        ThreadBuffer& buffer = threadBuffer();
+
+        uint64_t head = buffer.head.load(std::memory_order_relaxed);
+        if (head - buffer.tail.load(std::memory_order_acquire) >= RING_SIZE)
+        {
+            buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        buffer.events[head % RING_SIZE] = event;
+        buffer.head.store(head + 1, std::memory_order_release);
+    }
+
+    void writeEscaped(std::ofstream& file, const std::string& text)
+    {
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+                file << '\\';
+            file << c;
+        }
+    }
+
+    // Nanoseconds as exact microseconds. A double on the default stream precision keeps 6 digits,
+    // which is already 10 us of resolution one second into the run
+    void writeMicroseconds(std::ofstream& file, uint64_t ns)
+    {
+        uint64_t fraction = ns % 1000;
+        file << ns / 1000 << '.' << (fraction < 100 ? "0" : "") << (fraction < 10 ? "0" : "") << fraction;
+    }
+}
+
+void Trace::setEnabled(bool enable)
+{
+    enabled.store(enable, std::memory_order_relaxed);
+}
+
+bool Trace::isEnabled()
+{
+    return enabled.load(std::memory_order_relaxed);
+}
+
+uint64_t Trace::now()
+{
+    // Never 0, Scope uses it as "not started"
+    auto elapsed = std::chrono::steady_clock::now() - epoch;
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) + 1;
+}
+
+void Trace::setThreadName(const std::string& name)
+{
+    uint32_t tid = threadId();
+
+    Registry& reg = registry();
+    std::lock_guard lock(reg.mutex);
+    reg.names.push_back({ tid, name });
+}
+
+uint32_t Trace::createTrack(const std::string& name)
+{
+    Registry& reg = registry();
+    std::lock_guard lock(reg.mutex);
+
+    uint32_t track = reg.nextTrack++;
+    reg.names.push_back({ track, name });
+    return track;
+}
+
+void Trace::complete(const char* name, const char* category, uint64_t startNs, uint64_t durationNs, uint32_t track, uint64_t arg)
+{
+    if (!isEnabled())
+        return;
+
+    push({ name, category, startNs, durationNs, arg, track, EventType::Complete });
+}
+
+void Trace::instant(const char* name, const char* category, uint64_t arg)
+{
+    if (!isEnabled())
+        return;
+
+    push({ name, category, now(), 0, arg, 0, EventType::Instant });
+}
+
+void Trace::collect()
+{
+    Registry& reg = registry();
+    std::lock_guard lock(reg.mutex);
+
+    for (auto& buffer : reg.buffers)
+    {
+        uint64_t tail = buffer->tail.load(std::memory_order_relaxed);
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        for (uint64_t i = tail; i < head; i++)
+            reg.collected.push_back({ buffer->events[i % RING_SIZE], buffer->tid });
+
+        buffer->tail.store(head, std::memory_order_release);
+    }
+
+    if (reg.collected.size() > MAX_COLLECTED)
+    {
+        size_t excess = reg.collected.size() - MAX_COLLECTED;
+        reg.collected.erase(reg.collected.begin(), reg.collected.begin() + static_cast<std::ptrdiff_t>(excess));
+        reg.discarded += excess;
+    }
+}
+
+uint64_t Trace::discardedEvents()
+{
+    Registry& reg = registry();
+    std::lock_guard lock(reg.mutex);
+    return reg.discarded;
+}
+
+size_t Trace::collectedBytes()
+{
+    Registry& reg = registry();
+    std::lock_guard lock(reg.mutex);
+    return reg.collected.size() * sizeof(CollectedEvent);
+}
+
+size_t Trace::collectedCapacityBytes()
+{
+    return MAX_COLLECTED * sizeof(CollectedEvent);
+}
+
+uint64_t Trace::droppedEvents()
+{
+    Registry& reg = registry();
+    std::lock_guard lock(reg.mutex);
+
+    uint64_t dropped = 0;
+    for (const auto& buffer : reg.buffers)
+        dropped += buffer->dropped.load(std::memory_order_relaxed);
+
+    return dropped;
+}
+
+size_t Trace::eventCount()
+{
+    collect();
+
+    Registry& reg = registry();
+    std::lock_guard lock(reg.mutex);
+    return reg.collected.size();
+}
+
+void Trace::clear()
+{
+    collect();
+
+    Registry& reg = registry();
+    std::lock_guard lock(reg.mutex);
+    reg.collected.clear();
+    reg.discarded = 0;
+}
+
+void Trace::writeChromeJson(const std::string& path)
+{
+    collect();
+
+    std::ofstream file(path);
+    if (!file.is_open())
+        throw std::runtime_error("failed to open " + path);
+
+    Registry& reg = registry();
+    std::lock_guard lock(reg.mutex);
+
+    // Timestamps are in microseconds
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    for (const auto& collected : reg.collected)
+    {
+        const Event& event = collected.event;
+
+        file << (first ? "" : ",\n") << "{\"name\":\"";
+        writeEscaped(file, event.name);
+        file << "\",\"cat\":\"";
+        writeEscaped(file, event.category);
+        file << "\",\"pid\":1,\"tid\":" << (event.track ? event.track : collected.tid)
+            << ",\"ts\":";
+        writeMicroseconds(file, event.start);
+
+        if (event.type == EventType::Complete)
+        {
+            file << ",\"ph\":\"X\",\"dur\":";
+            writeMicroseconds(file, event.duration);
+        }
+        else
+            file << ",\"ph\":\"i\",\"s\":\"t\"";
+
+        file << ",\"args\":{\"value\":" << event.arg << "}}";
+        first = false;
+    }
+
+    for (const auto& track : reg.names)
+    {
+        file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << track.tid << ",\"args\":{\"name\":\"";
+        writeEscaped(file, track.name);
+        file << "\"}}";
+        first = false;
+    }
+    file << "\n]}\n";
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Low overhead timeline tracing. Every thread writes its events to its own ring buffer (single
+// producer/single consumer, no lock on the hot path), collect() drains them and writeChromeJson
+// dumps everything in the Chrome trace event format, which chrome://tracing and ui.perfetto.dev open.
+// Names and categories must be string literals, only the pointer is stored.
+// When tracing is disabled an event costs one relaxed atomic load
+namespace Trace
+{
+    void setEnabled(bool enable);
+    bool isEnabled();
+
+    // Current time on the trace clock, in nanoseconds
+    uint64_t now();
+
+    // Name of the calling thread in the trace
+    void setThreadName(const std::string& name);
+
+    // Tracks that aren't a CPU thread (GPU queues...), written to from any thread
+    uint32_t    createTrack(const std::string& name);
+
+    void complete(const char* name, const char* category, uint64_t startNs, uint64_t durationNs, uint32_t track = 0, uint64_t arg = 0);
+    void instant(const char* name, const char* category, uint64_t arg = 0);
+
+    // Moves the events of every thread out of the ring buffers. Call it regularly on long runs,
+    // a full ring drops the new events. The collected events are capped, past the cap the oldest go
+    void collect();
+
+    // Collects and writes the events since the start (or the last clear), up to the cap
+    void    writeChromeJson(const std::string& path);
+    size_t  eventCount();
+    void clear();
+
+    uint64_t droppedEvents();      // New events lost to a full ring
+    uint64_t discardedEvents();    // Old events pushed out of the collected ones by the cap
+
+    // Memory the collected events hold, and what it stays under
+    size_t  collectedBytes();
+    size_t  collectedCapacityBytes();
+
+    // Complete event around a C++ scope
+    class Scope
+    {
+    public:
+        Scope(const char* name_, const char* category_ = "cpu", uint64_t arg_ = 0)
+            : name(name_), category(category_), arg(arg_), start(isEnabled() ? now() : 0) {}
+        ~Scope()
+        {
+            if (start != 0 && isEnabled())
+                complete(name, category, start, now() - start, 0, arg);
+        }
+
+        Scope(const Scope&)            = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        const char* name;
+        const char* category;
+        uint64_t    arg;
+        uint64_t    start;
+    };
+}
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(...) Trace::Scope TRACE_CONCAT(traceScope, __LINE__)(__VA_ARGS__)
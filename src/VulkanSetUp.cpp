@@ -1,18 +1,18 @@
 #include "VulkanSetUp.h"
+#include "Trace.h"
+#include "ResourceTracker.h"
 #include <fstream>
+#include <cstring>
+#include <cstddef>
+#include <cmath>
+#include <cctype>
+#include <algorithm>
+#include <chrono>
+#include <charconv>
 
-#pragma region VULKAN DEBUG HELPER FUNCTIONS
-static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
-    VkDebugUtilsMessageSeverityFlagBitsEXT msgSeverity,
-    VkDebugUtilsMessageTypeFlagsEXT msgType,
-    const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
-    void* pUserData)
-{
-    std::cerr << "validation layer: " << pCallbackData->pMessage << std::endl;
-
-    return VK_FALSE;
-}
+#include <glm/gtc/matrix_transform.hpp>
 
+#pragma region VULKAN DEBUG HELPER FUNCTIONS
 static VkResult CreateDebugUtilsMessengerEXT(
     VkInstance instance,
     const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo,
@@ -38,25 +38,84 @@ static void DestroyDebugUtilsMessengerEXT(
 #pragma endregion
 
 void VKSetUp::InitWindow(unsigned width, unsigned height)
+{
+    addWindow(width, height);
+}
+
+size_t VKSetUp::addWindow(unsigned width, unsigned height)
 {
     // Initialize GLFW
-    glfwInit();
+    if (!glfwInitialized)
+    {
+        glfwInit();
+        glfwInitialized = true;
+    }
 
     // Initialize the window without using OpenGL context
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
     glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
 
     // Create the window
-    window = glfwCreateWindow(width, height, "Vulkan", nullptr, nullptr);
+    RenderView view;
+    view.window = glfwCreateWindow(width, height, "Vulkan", nullptr, nullptr);
+    view.index  = static_cast<uint32_t>(views.size());
+    views.push_back(view);
+
+    return views.size() - 1;
+}
+
+size_t VKSetUp::addHeadlessView(unsigned width, unsigned height)
+{
+    // Renders into an offscreen image, no window nor swap chain
+    RenderView view;
+    view.extent = { width, height };
+    view.index  = static_cast<uint32_t>(views.size());
+    views.push_back(view);
+
+    return views.size() - 1;
+}
+
+GLFWwindow* VKSetUp::getWindow() const
+{
+    for (const auto& view : views)
+    {
+        if (view.window)
+            return view.window;
+    }
+
+    return nullptr;
+}
+
+bool VKSetUp::shouldClose() const
+{
+    return std::any_of(views.begin(), views.end(), [](const RenderView& view)
+        { return view.window && glfwWindowShouldClose(view.window); });
+}
+
+bool VKSetUp::hasWindows() const
+{
+    return getWindow() != nullptr;
+}
+
+std::vector<const char*> VKSetUp::requiredDeviceExtensions() const
+{
+    // Headless only runs don't need the swap chain
+    return hasWindows() ? deviceExtensions : std::vector<const char*>{};
 }
 
 std::vector<const char*> VKSetUp::getRequiredExtensions(const bool& enableLayer)
 {
-    unsigned int glfwExtensionCount = 0;
-    const char** glfwExtensions;
+    std::vector<const char*> extensions;
+
+    // Surface extensions, only if there is something to present to
+    if (hasWindows())
+    {
+        unsigned int glfwExtensionCount = 0;
+        const char** glfwExtensions;
 
-    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-    std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    }
 
     if (enableLayer)
         extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -105,47 +164,213 @@ bool VKSetUp::checkDeviceExtensionSupport(const VkPhysicalDevice& device_) const
     vkEnumerateDeviceExtensionProperties(device_, nullptr, &extensionCount, availableExtension.data());
 
     // If the extension VK_KHR_swapchain is there, then it means that it's capable of creating a swap chain
-    std::set<std::string> requiredExtension(deviceExtensions.begin(), deviceExtensions.end());
+    std::vector<const char*> required = requiredDeviceExtensions();
+    std::set<std::string> requiredExtension(required.begin(), required.end());
     for (const auto& extension : availableExtension)
         requiredExtension.erase(extension.extensionName);
 
     return requiredExtension.empty();
 }
 
-bool VKSetUp::isDeviceSuitable(const VkPhysicalDevice& device_) const
+bool VKSetUp::isDeviceSuitable(const VkPhysicalDevice& device_, QueueFamilyIndices& idx, std::vector<SwapChainSupportDetails>& supports) const
 {
-    // Checks for a dedicated graphics card that support geometry shaders
-    /*VkPhysicalDeviceProperties deviceProperties;
-    VkPhysicalDeviceFeatures deviceFeatures;
-    vkGetPhysicalDeviceProperties(device, &deviceProperties);
-    vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
-
-    return deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU && deviceFeatures.geometryShader;*/
-
-    // For now, just use the first GPU that it encounters
-    QueueFamilyIndices idx = findQueueFamily(device_);
+    // The renderer relies on Vulkan 1.3 (dynamic rendering and synchronization2),
+    // pickPhysicalDevice ranks whatever passes these checks
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(device_, &deviceProperties);
+    if (deviceProperties.apiVersion < VK_API_VERSION_1_3)
+        return false;
+
+    // The queue families and surface details are handed back, so the picked device isn't queried again
+    idx = findQueueFamily(device_);
     bool extensionSupport = checkDeviceExtensionSupport(device_);
-    bool swapchain = false;
-    if (extensionSupport)
+    bool swapchain = extensionSupport;
+    supports.assign(views.size(), SwapChainSupportDetails{});
+    for (size_t i = 0; i < views.size(); i++)
     {
-        SwapChainSupportDetails swapChainDetails = querySwapChainSupport(device_);
-        swapchain = !swapChainDetails.formats.empty() && !swapChainDetails.presentModes.empty();
+        if (!swapchain || !views[i].surface)
+            continue;
+
+        supports[i] = querySwapChainSupport(device_, views[i].surface);
+        swapchain = !supports[i].formats.empty() && !supports[i].presentModes.empty();
     }
 
     return idx.isComplete() && extensionSupport && swapchain;
 }
 
+DeviceCapabilities VKSetUp::queryDeviceCapabilities(const VkPhysicalDevice& device_) const
+{
+    DeviceCapabilities caps;
+
+    // Extensions
+    unsigned extensionCount;
+    vkEnumerateDeviceExtensionProperties(device_, nullptr, &extensionCount, nullptr);
+
+    std::vector<VkExtensionProperties> availableExtension(extensionCount);
+    vkEnumerateDeviceExtensionProperties(device_, nullptr, &extensionCount, availableExtension.data());
+
+    bool meshShaderExt = std::any_of(availableExtension.begin(), availableExtension.end(), [](const VkExtensionProperties& ext)
+        { return strcmp(ext.extensionName, VK_EXT_MESH_SHADER_EXTENSION_NAME) == 0; });
+
+    // Properties, with the UUID to identify the device across runs
+    VkPhysicalDeviceIDProperties idProps{};
+    idProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+
+    VkPhysicalDeviceProperties2 props{};
+    props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    props.pNext = &idProps;
+    vkGetPhysicalDeviceProperties2(device_, &props);
+
+    caps.name       = props.properties.deviceName;
+    caps.type       = props.properties.deviceType;
+    caps.apiVersion = props.properties.apiVersion;
+
+    const char* hexDigits = "0123456789abcdef";
+    for (uint32_t i = 0; i < VK_UUID_SIZE; i++)
+    {
+        caps.uuid += hexDigits[idProps.deviceUUID[i] >> 4];
+        caps.uuid += hexDigits[idProps.deviceUUID[i] & 0xF];
+    }
+
+    const VkPhysicalDeviceLimits& limits = props.properties.limits;
+    caps.timestamps         = limits.timestampComputeAndGraphics == VK_TRUE;
+    caps.timestampPeriod    = limits.timestampPeriod;
+    caps.sampleCounts       = limits.framebufferColorSampleCounts & limits.framebufferDepthSampleCounts;
+
+    // Memory
+    VkPhysicalDeviceMemoryProperties memProps;
+    vkGetPhysicalDeviceMemoryProperties(device_, &memProps);
+    for (uint32_t i = 0; i < memProps.memoryHeapCount; i++)
+    {
+        if (memProps.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+            caps.deviceLocalMemory += memProps.memoryHeaps[i].size;
+    }
+
+    // Queue families
+    unsigned queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(device_, &queueFamilyCount, nullptr);
+
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(device_, &queueFamilyCount, queueFamilies.data());
+
+    for (const auto& queueFamily : queueFamilies)
+    {
+        VkQueueFlags flags = queueFamily.queueFlags;
+        if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT))
+            caps.dedicatedCompute = true;
+        if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+            caps.dedicatedTransfer = true;
+    }
+
+    // Features. Only chain the mesh shader ones if the extension is there
+    VkPhysicalDeviceMeshShaderFeaturesEXT meshFeatures{};
+    meshFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = meshShaderExt ? &meshFeatures : nullptr;
+    vkGetPhysicalDeviceFeatures2(device_, &features);
+
+    caps.meshShader                 = meshShaderExt && meshFeatures.taskShader && meshFeatures.meshShader;
+    caps.multiDrawIndirect          = features.features.multiDrawIndirect == VK_TRUE;
+    caps.drawIndirectFirstInstance  = features.features.drawIndirectFirstInstance == VK_TRUE;
+
+    return caps;
+}
+
+static int rateDevice(const DeviceCapabilities& caps)
+{
+    // The device type dominates, so a big integrated GPU never beats a discrete one
+    int score = 0;
+    switch (caps.type)
+    {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:   score += 100000; break;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: score += 10000;  break;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:    score += 5000;   break;
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:            score += 100;    break;
+    default: break;
+    }
+
+    // 1 point per 64 MiB of device local memory
+    score += static_cast<int>(std::min<VkDeviceSize>(caps.deviceLocalMemory >> 26, 4096));
+
+    // Async queues and the fast paths the renderer can use
+    if (caps.dedicatedCompute)
+        score += 500;
+    if (caps.dedicatedTransfer)
+        score += 500;
+    if (caps.meshShader)
+        score += 2000;
+    if (caps.multiDrawIndirect && caps.drawIndirectFirstInstance)
+        score += 500;
+
+    return score;
+}
+
+static std::string toLower(std::string str)
+{
+    std::transform(str.begin(), str.end(), str.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return str;
+}
+
+static bool matchesDeviceOverride(const DeviceCapabilities& caps, const std::string& override_)
+{
+    // Enumeration index. Only short numbers, a longer run of digits is a UUID or part of a name
+    if (!override_.empty() && override_.size() <= 3)
+    {
+        unsigned index = 0;
+        const char* end = override_.data() + override_.size();
+        auto [ptr, ec] = std::from_chars(override_.data(), end, index);
+        if (ec == std::errc() && ptr == end)
+            return index == caps.index;
+    }
+
+    // UUID, with or without the dashes
+    std::string uuid;
+    for (char c : toLower(override_))
+    {
+        if (c != '-')
+            uuid += c;
+    }
+    if (uuid == caps.uuid)
+        return true;
+
+    // Any part of the name
+    return toLower(caps.name).find(toLower(override_)) != std::string::npos;
+}
+
+// The option wins over the environment variable
+static std::string resolveDeviceOverride(const std::string& option)
+{
+    if (option.empty() && std::getenv("VKPROJ_DEVICE"))
+        return std::getenv("VKPROJ_DEVICE");
+
+    return option;
+}
+
 void VKSetUp::populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& info)
 {
     info                    = {};
     info.sType              = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
-    info.messageSeverity    = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT | 
-                              VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | 
-                              VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
-    info.messageType        = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT |
-                              VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
-                              VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
-    info.pfnUserCallback    = debugCallback;
+    // Only ask the layers for what passes the filter, filtered out messages aren't even generated
+    DebugFilter filter      = debugSink->getFilter();
+    info.messageSeverity    = filter.severities;
+    info.messageType        = filter.types;
+    info.pfnUserCallback    = DebugSink::callback;
+    info.pUserData          = debugSink.get();
+}
+
+void VKSetUp::setDebugFilter(const DebugFilter& filter)
+{
+    debugSink->setFilter(filter);
+
+    // The messenger was created with the previous masks
+    if (debugMessenger)
+    {
+        destroyDebugMessenger();
+        debugMessenger = nullptr;
+        setupDebugMessenger(true);
+    }
 }
 
 void VKSetUp::setupDebugMessenger(const bool& enableLayer)
@@ -158,8 +383,9 @@ void VKSetUp::setupDebugMessenger(const bool& enableLayer)
     populateDebugMessengerCreateInfo(createDInfo);
 
     // Create the debug messenger
-    if (CreateDebugUtilsMessengerEXT(instance, &createDInfo, nullptr, &debugMessenger) != VK_SUCCESS)
+    if (CreateDebugUtilsMessengerEXT(instance, &createDInfo, ResourceTracker::allocator(), &debugMessenger) != VK_SUCCESS)
         throw std::runtime_error("failed to set up the debug messenger");
+    ResourceTracker::created(VK_OBJECT_TYPE_DEBUG_UTILS_MESSENGER_EXT, debugMessenger);
 }
 
 void VKSetUp::pickPhysicalDevice()
@@ -171,35 +397,151 @@ void VKSetUp::pickPhysicalDevice()
     if (deviceCount == 0)
         throw std::runtime_error("failed to find GPUs with Vulkan support!");
 
-    // Search for a specific GPU based on the isDeviceSuitable function
     std::vector<VkPhysicalDevice> devices(deviceCount);
     vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
-    for (const auto& device : devices)
+
+    std::string override_ = resolveDeviceOverride(deviceOverride);
+
+    // Score all the suitable GPUs and keep the best one (among the ones matching the override, if any)
+    int bestScore = -1;
+    std::vector<SwapChainSupportDetails> bestSupports;
+    for (unsigned i = 0; i < deviceCount; i++)
     {
-        if (isDeviceSuitable(device))
+        QueueFamilyIndices                      idx;
+        std::vector<SwapChainSupportDetails>    supports;
+        if (!isDeviceSuitable(devices[i], idx, supports))
+            continue;
+
+        DeviceCapabilities caps = queryDeviceCapabilities(devices[i]);
+        caps.index = i;
+        caps.score = rateDevice(caps);
+
+        if (!override_.empty() && !matchesDeviceOverride(caps, override_))
+            continue;
+
+        if (caps.score > bestScore)
         {
-            physicalDevice = device;
-            break;
+            bestScore       = caps.score;
+            physicalDevice  = devices[i];
+            capabilities    = caps;
+            queueFamilies   = idx;
+            bestSupports    = std::move(supports);
         }
     }
 
     if (physicalDevice == VK_NULL_HANDLE)
+    {
+        if (!override_.empty())
+            throw std::runtime_error("no suitable GPU matches \"" + override_ + "\"");
+
         throw std::runtime_error("failed to find a suitable GPU!");
+    }
+
+    for (size_t i = 0; i < views.size(); i++)
+        views[i].support = std::move(bestSupports[i]);
+
+    // Select the meshlet codepath now, the logical device enables whatever it needs
+    meshletPath = RenderPath::Classic;
+    if (meshletScene && capabilities.meshShader)
+        meshletPath = RenderPath::MeshletTask;
+    else if (meshletScene && capabilities.multiDrawIndirect && capabilities.drawIndirectFirstInstance)
+        meshletPath = RenderPath::MeshletCompute;   // One indirect draw per meshlet, firstInstance is the meshlet index
+
+    renderPath = meshletPath;
+}
+
+void VKSetUp::printDevices(std::ostream& out) const
+{
+    unsigned deviceCount = 0;
+    vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
+
+    std::vector<VkPhysicalDevice> devices(deviceCount);
+    vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
+
+    std::string override_ = resolveDeviceOverride(deviceOverride);
+
+    // Same ranking as pickPhysicalDevice, the one it would pick is marked
+    int         bestScore = -1;
+    unsigned    best      = deviceCount;
+    std::vector<DeviceCapabilities> candidates;
+    for (unsigned i = 0; i < deviceCount; i++)
+    {
+        QueueFamilyIndices                      idx;
+        std::vector<SwapChainSupportDetails>    supports;
+        if (!isDeviceSuitable(devices[i], idx, supports))
+        {
+            VkPhysicalDeviceProperties properties;
+            vkGetPhysicalDeviceProperties(devices[i], &properties);
+            out << "GPU " << i << ": " << properties.deviceName << " (unsuitable)" << std::endl;
+            continue;
+        }
+
+        DeviceCapabilities caps = queryDeviceCapabilities(devices[i]);
+        caps.index = i;
+        caps.score = rateDevice(caps);
+
+        if ((override_.empty() || matchesDeviceOverride(caps, override_)) && caps.score > bestScore)
+        {
+            bestScore = caps.score;
+            best      = i;
+        }
+        candidates.push_back(std::move(caps));
+    }
+
+    for (const auto& caps : candidates)
+    {
+        out << "GPU " << caps.index << ": " << caps.name << " (score " << caps.score << ", uuid " << caps.uuid << ")"
+            << (caps.index == best ? " <- picked" : "") << std::endl;
+    }
+}
+
+void VKSetUp::setRenderPath(RenderPath path)
+{
+    if (path != RenderPath::Classic && path != meshletPath)
+        throw std::runtime_error("render path not supported by the device");
+
+    if (path == RenderPath::Classic && meshLayout)
+        compilePipelineVariant(CapturePipeline::Classic, shaderFeatures, true);
+
+    renderPath = path;
 }
 
 VkSurfaceFormatKHR VKSetUp::chooseSwapChainSurfaceFormat(const SwapChainSupportDetails& details)
 {
+    // Once a view picked the format, the other ones have to match it since they share the pipelines
+    VkFormat wanted = mFormat != VK_FORMAT_UNDEFINED ? mFormat : VK_FORMAT_B8G8R8A8_SRGB;
     for (const auto& formats : details.formats)
     {
-        if (formats.format == VK_FORMAT_B8G8R8A8_SRGB && formats.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR)
+        if (formats.format == wanted && formats.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR)
             return formats;
     }
 
+    if (mFormat != VK_FORMAT_UNDEFINED)
+    {
+        // The format picked first may not come in the sRGB color space
+        for (const auto& formats : details.formats)
+        {
+            if (formats.format == mFormat)
+                return formats;
+        }
+        throw std::runtime_error("the windows don't share a surface format");
+    }
+
     return details.formats.front();
 }
 
 VkPresentModeKHR VKSetUp::chooseSwapPresentMode(const SwapChainSupportDetails& details)
 {
+    // Benchmarks don't want to be capped by the refresh rate
+    if (uncappedPresent)
+    {
+        for (const auto& present : details.presentModes)
+        {
+            if (present == VK_PRESENT_MODE_IMMEDIATE_KHR)
+                return present;
+        }
+    }
+
     for (const auto& present : details.presentModes)
     {
         if (present == VK_PRESENT_MODE_MAILBOX_KHR)
@@ -209,7 +551,7 @@ VkPresentModeKHR VKSetUp::chooseSwapPresentMode(const SwapChainSupportDetails& d
     return VK_PRESENT_MODE_FIFO_KHR;
 }
 
-VkExtent2D VKSetUp::chooseSwapExtent(const SwapChainSupportDetails& details)
+VkExtent2D VKSetUp::chooseSwapExtent(const SwapChainSupportDetails& details, GLFWwindow* window)
 {
     if (details.capabilities.currentExtent.width != std::numeric_limits<unsigned>::max())
         return details.capabilities.currentExtent;
@@ -233,15 +575,17 @@ VkShaderModule VKSetUp::createShaderModule(const std::vector<char>& code) const
     createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
 
     VkShaderModule shadModule;
-    if (vkCreateShaderModule(device, &createInfo, nullptr, &shadModule) != VK_SUCCESS)
+    if (vkCreateShaderModule(device, &createInfo, ResourceTracker::allocator(), &shadModule) != VK_SUCCESS)
         throw std::runtime_error("failed to create shader module!");
+    ResourceTracker::created(VK_OBJECT_TYPE_SHADER_MODULE, shadModule);
 
     return shadModule;
 }
 
 void VKSetUp::createLogicalDevice()
 {
-    QueueFamilyIndices idx = findQueueFamily(physicalDevice);
+    // Queried once in pickPhysicalDevice
+    const QueueFamilyIndices& idx = queueFamilies;
 
     // Information about the queues
     std::vector<VkDeviceQueueCreateInfo> createQInfos;
@@ -257,35 +601,60 @@ void VKSetUp::createLogicalDevice()
         createQInfos.push_back(createQInfo);
     }
 
-    // Enable dynamic rendering
-    VkPhysicalDeviceDynamicRenderingFeatures dynamicRenderingFeatures{};
-    dynamicRenderingFeatures.sType              = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES;
-    dynamicRenderingFeatures.dynamicRendering   = VK_TRUE;
+    // Dynamic rendering and synchronization2 are required, the rest are the fast paths the device supports
+    VkPhysicalDeviceVulkan13Features features13{};
+    features13.sType            = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+    features13.dynamicRendering = VK_TRUE;
+    features13.synchronization2 = VK_TRUE;
+
+    deviceFeatures.multiDrawIndirect            = capabilities.multiDrawIndirect;
+    deviceFeatures.drawIndirectFirstInstance    = capabilities.drawIndirectFirstInstance;
+
+    // Mesh shaders are only enabled if the meshlet path picked in pickPhysicalDevice uses them
+    std::vector<const char*> extensions = requiredDeviceExtensions();
+    VkPhysicalDeviceMeshShaderFeaturesEXT meshFeatures{};
+    meshFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+    if (meshletPath == RenderPath::MeshletTask)
+    {
+        meshFeatures.taskShader = VK_TRUE;
+        meshFeatures.meshShader = VK_TRUE;
+        features13.pNext        = &meshFeatures;
+        extensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+    }
 
     // Information about the device/GPU
     VkDeviceCreateInfo createDevInfo{};
     createDevInfo.sType                     = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-    createDevInfo.pNext                     = &dynamicRenderingFeatures;
+    createDevInfo.pNext                     = &features13;
     createDevInfo.queueCreateInfoCount      = static_cast<unsigned>(createQInfos.size());
     createDevInfo.pQueueCreateInfos         = createQInfos.data();
     createDevInfo.pEnabledFeatures          = &deviceFeatures;
-    createDevInfo.ppEnabledExtensionNames   = deviceExtensions.data();
-    createDevInfo.enabledExtensionCount     = static_cast<unsigned>(deviceExtensions.size());
+    createDevInfo.ppEnabledExtensionNames   = extensions.data();
+    createDevInfo.enabledExtensionCount     = static_cast<unsigned>(extensions.size());
 
     // Create the logical device
-    if (vkCreateDevice(physicalDevice, &createDevInfo, nullptr, &device) != VK_SUCCESS)
+    if (vkCreateDevice(physicalDevice, &createDevInfo, ResourceTracker::allocator(), &device) != VK_SUCCESS)
         throw std::runtime_error("failed to create logical device!");
+    ResourceTracker::created(VK_OBJECT_TYPE_DEVICE, device);
 
     // Get the handles for the graphics and presentation queues. The 0 is the queue index, if there is more than one, 
     // we need to pass the corresponding indices
     vkGetDeviceQueue(device, idx.graphicsFamily.value(), 0, &graphicsQueue);
     vkGetDeviceQueue(device, idx.presentFamily.value(), 0, &presentQueue);
+
+    // Extension commands aren't exported by the loader
+    if (meshletPath == RenderPath::MeshletTask)
+        pfnCmdDrawMeshTasks = (PFN_vkCmdDrawMeshTasksEXT)vkGetDeviceProcAddr(device, "vkCmdDrawMeshTasksEXT");
 }
 
 void VKSetUp::createSurface()
 {
-    if (glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS)
-        throw std::runtime_error("failed to create window surface");
+    for (auto& view : views)
+    {
+        if (view.window && glfwCreateWindowSurface(instance, view.window, ResourceTracker::allocator(), &view.surface) != VK_SUCCESS)
+            throw std::runtime_error("failed to create window surface");
+        ResourceTracker::created(VK_OBJECT_TYPE_SURFACE_KHR, view.surface);
+    }
 }
 
 void VKSetUp::createInstance(const bool& enableLayer)
@@ -299,6 +668,10 @@ void VKSetUp::createInstance(const bool& enableLayer)
     if (enableLayer && !checkValidationLayerSupport())
         throw std::runtime_error("validation layer requested, but no available");
 
+    // Messages are printed off the calling thread
+    if (enableLayer)
+        debugSink->start();
+
     // Information about the program
     VkApplicationInfo appInfo{};
     appInfo.sType               = VK_STRUCTURE_TYPE_APPLICATION_INFO;
@@ -335,71 +708,251 @@ void VKSetUp::createInstance(const bool& enableLayer)
     }
 
     // Create the instance
-    if (vkCreateInstance(&createInfo, nullptr, &instance) != VK_SUCCESS)
+    if (vkCreateInstance(&createInfo, ResourceTracker::allocator(), &instance) != VK_SUCCESS)
         throw std::runtime_error("failed to create the instance");
+    ResourceTracker::created(VK_OBJECT_TYPE_INSTANCE, instance);
+}
+
+void VKSetUp::selectFormats()
+{
+    if (formatsSelected)
+        return;
+
+    // Every view has to agree on the format, chooseSwapChainSurfaceFormat throws otherwise
+    for (const auto& view : views)
+    {
+        if (view.surface)
+            mFormat = chooseSwapChainSurfaceFormat(view.support).format;
+    }
+
+    // Headless views render into an image of the same format, so they can use the same pipelines
+    if (mFormat == VK_FORMAT_UNDEFINED)
+        mFormat = VK_FORMAT_R8G8B8A8_SRGB;
+
+    if (meshletScene)
+    {
+        // First format usable as a depth attachment, D16 is always supported
+        for (VkFormat format : { VK_FORMAT_D32_SFLOAT, VK_FORMAT_X8_D24_UNORM_PACK32, VK_FORMAT_D16_UNORM })
+        {
+            VkFormatProperties formatProps;
+            vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProps);
+            if (formatProps.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+            {
+                depthFormat = format;
+                break;
+            }
+        }
+    }
+
+    // Highest sample count under the cap that both the color and the depth attachments support
+    msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+    for (uint32_t count = VK_SAMPLE_COUNT_64_BIT; count > VK_SAMPLE_COUNT_1_BIT; count >>= 1)
+    {
+        if (count <= msaaCap && (capabilities.sampleCounts & count))
+        {
+            msaaSamples = static_cast<VkSampleCountFlagBits>(count);
+            break;
+        }
+    }
+
+    if (msaaCap > 1)
+        std::cout << "msaa: " << msaaSamples << " samples per pixel (up to " << msaaCap << " asked)" << std::endl;
+
+    formatsSelected = true;
 }
 
 void VKSetUp::createSwapChain()
 {
-    // Get the surface details to render onto the window
-    SwapChainSupportDetails details = querySwapChainSupport(physicalDevice);
-
-    VkSurfaceFormatKHR surfaceFormat = chooseSwapChainSurfaceFormat(details);
-    VkPresentModeKHR presentMode     = chooseSwapPresentMode(details);
-    VkExtent2D extent                = chooseSwapExtent(details);
-
-    // Get the amount of images to have in the swap chain
-    unsigned imgCount = details.capabilities.minImageCount + 1;
-    if (details.capabilities.maxImageCount > 0 && imgCount > details.capabilities.maxImageCount)
-        imgCount = details.capabilities.maxImageCount;
-
-    // Information about swap chain
-    VkSwapchainCreateInfoKHR createSCIfno{};
-    createSCIfno.sType            = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-    createSCIfno.surface          = surface;
-    createSCIfno.minImageCount    = imgCount;
-    createSCIfno.imageFormat      = surfaceFormat.format;
-    createSCIfno.imageColorSpace  = surfaceFormat.colorSpace;
-    createSCIfno.imageExtent      = extent;
-    createSCIfno.imageArrayLayers = 1;
-    createSCIfno.imageUsage       = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-
-    QueueFamilyIndices idx = findQueueFamily(physicalDevice);
-    unsigned indices[] = { idx.graphicsFamily.value(), idx.presentFamily.value() };
-    if (idx.graphicsFamily != idx.presentFamily)
-    {
-        createSCIfno.imageSharingMode       = VK_SHARING_MODE_CONCURRENT;
-        createSCIfno.queueFamilyIndexCount  = 2;
-        createSCIfno.pQueueFamilyIndices    = indices;
+    const QueueFamilyIndices& idx = queueFamilies;
+
+    selectFormats();
+
+    // The dynamic resolution needs timestamps to measure the GPU
+    if (drs.enabled && !capabilities.timestamps)
+    {
+        std::cout << "dynamic resolution disabled: no timestamp support" << std::endl;
+        drs.enabled = false;
     }
-    else
+
+    // ... and swap chain images that can be blitted into
+    for (const auto& view : views)
+    {
+        if (drs.enabled && view.window
+            && !(view.support.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT))
+        {
+            std::cout << "dynamic resolution disabled: the swap chain can't be a transfer destination" << std::endl;
+            drs.enabled = false;
+        }
+    }
+
+    for (auto& view : views)
+    {
+        if (!view.window)
+            continue;
+
+        // Get the surface details to render onto the window
+        const SwapChainSupportDetails& details = view.support;
+
+        VkSurfaceFormatKHR surfaceFormat = chooseSwapChainSurfaceFormat(details);
+        VkPresentModeKHR presentMode     = chooseSwapPresentMode(details);
+        VkExtent2D extent                = chooseSwapExtent(details, view.window);
+
+        // Get the amount of images to have in the swap chain
+        unsigned imgCount = details.capabilities.minImageCount + 1;
+        if (details.capabilities.maxImageCount > 0 && imgCount > details.capabilities.maxImageCount)
+            imgCount = details.capabilities.maxImageCount;
+
+        // Information about swap chain
+        VkSwapchainCreateInfoKHR createSCIfno{};
+        createSCIfno.sType            = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+        createSCIfno.surface          = view.surface;
+        createSCIfno.minImageCount    = imgCount;
+        createSCIfno.imageFormat      = surfaceFormat.format;
+        createSCIfno.imageColorSpace  = surfaceFormat.colorSpace;
+        createSCIfno.imageExtent      = extent;
+        createSCIfno.imageArrayLayers = 1;
+        createSCIfno.imageUsage       = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        if (drs.enabled)
+            createSCIfno.imageUsage  |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;  // Target of the upscale blit
+
+        unsigned indices[] = { idx.graphicsFamily.value(), idx.presentFamily.value() };
+        if (idx.graphicsFamily != idx.presentFamily)
+        {
+            createSCIfno.imageSharingMode       = VK_SHARING_MODE_CONCURRENT;
+            createSCIfno.queueFamilyIndexCount  = 2;
+            createSCIfno.pQueueFamilyIndices    = indices;
+        }
+        else
+        {
+            createSCIfno.imageSharingMode       = VK_SHARING_MODE_EXCLUSIVE;
+            createSCIfno.queueFamilyIndexCount  = 0;        // Optional
+            createSCIfno.pQueueFamilyIndices    = nullptr;  // Optional
+        }
+
+        createSCIfno.preTransform   = details.capabilities.currentTransform;
+        createSCIfno.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+        createSCIfno.presentMode    = presentMode;
+        createSCIfno.clipped        = VK_TRUE;
+        createSCIfno.oldSwapchain   = VK_NULL_HANDLE;
+
+        // Create the swap chain
+        if (vkCreateSwapchainKHR(device, &createSCIfno, ResourceTracker::allocator(), &view.swapChain) != VK_SUCCESS)
+            throw std::runtime_error("failed to create swap chain!");
+        ResourceTracker::created(VK_OBJECT_TYPE_SWAPCHAIN_KHR, view.swapChain);
+
+        // Get the handles for the images of the swap chain
+        vkGetSwapchainImagesKHR(device, view.swapChain, &imgCount, nullptr);
+        view.images.resize(imgCount);
+        vkGetSwapchainImagesKHR(device, view.swapChain, &imgCount, view.images.data());
+
+        view.extent = extent;
+    }
+
+    for (auto& view : views)
+    {
+        if (view.window)
+            continue;
+
+        view.offscreen = createImage(view.extent, mFormat,
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+            VK_IMAGE_ASPECT_COLOR_BIT);
+        view.images     = { view.offscreen.image };
+        view.imageViews = { view.offscreen.view };
+
+        if (readback)
+        {
+            VkDeviceSize size = static_cast<VkDeviceSize>(view.extent.width) * view.extent.height * 4;
+            view.readback = createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            vkMapMemory(device, view.readback.memory, 0, size, 0, &view.readbackData);
+        }
+    }
+
+    // The upscale is a linear blit, the format has to support it
+    VkFormatProperties formatProps;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, mFormat, &formatProps);
+    VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    if (drs.enabled && (formatProps.optimalTilingFeatures & blitFeatures) != blitFeatures)
+    {
+        std::cout << "dynamic resolution disabled: the color format can't be blitted" << std::endl;
+        drs.enabled = false;
+    }
+
+    if (drs.enabled)
     {
-        createSCIfno.imageSharingMode       = VK_SHARING_MODE_EXCLUSIVE;
-        createSCIfno.queueFamilyIndexCount  = 0;        // Optional
-        createSCIfno.pQueueFamilyIndices    = nullptr;  // Optional
+        for (auto& view : views)
+            view.resolutionScale = drs.maxScale;
+
+        telemetry.assign(8192, ResolutionSample{});
     }
 
-    createSCIfno.preTransform   = details.capabilities.currentTransform;
-    createSCIfno.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-    createSCIfno.presentMode    = presentMode;
-    createSCIfno.clipped        = VK_TRUE;
-    createSCIfno.oldSwapchain   = VK_NULL_HANDLE;
+    createRenderTargets();
+}
+
+void VKSetUp::createRenderTargets()
+{
+    // Passes of a view in the frame: its scene, then its upscale. Views are submitted in order
+    const uint32_t passesPerView = 2;
+
+    for (auto& view : views)
+    {
+        uint32_t scenePass = view.index * passesPerView;
+
+        // Only read by the depth test of the scene pass
+        if (meshletScene)
+        {
+            RenderTargetDesc desc;
+            desc.name       = "depth";
+            desc.format     = depthFormat;
+            desc.extent     = view.extent;
+            desc.samples    = msaaSamples;
+            desc.usage      = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+            desc.aspect     = VK_IMAGE_ASPECT_DEPTH_BIT;
+            desc.firstPass  = scenePass;
+            desc.lastPass   = scenePass;
+            desc.stages     = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+            desc.access     = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            view.depth      = renderTargets.add(desc);
+        }
 
-    // Create the swap chain
-    if (vkCreateSwapchainKHR(device, &createSCIfno, nullptr, &swapChain) != VK_SUCCESS)
-        throw std::runtime_error("failed to create swap chain!");
+        // The samples are only needed until the resolve at the end of the scene pass. Never stored: on a
+        // tiler they stay in tile memory and only the resolved pixels are written out
+        if (msaaSamples != VK_SAMPLE_COUNT_1_BIT)
+        {
+            RenderTargetDesc desc;
+            desc.name       = "msaa color";
+            desc.format     = mFormat;
+            desc.extent     = view.extent;
+            desc.samples    = msaaSamples;
+            desc.usage      = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+            desc.firstPass  = scenePass;
+            desc.lastPass   = scenePass;
+            desc.stages     = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+            desc.access     = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+            view.msaaColor  = renderTargets.add(desc);
+        }
 
-    // Get the handles for the images of the swap chain
-    vkGetSwapchainImagesKHR(device, swapChain, &imgCount, nullptr);
-    swapChainImages.resize(imgCount);
-    vkGetSwapchainImagesKHR(device, swapChain, &imgCount, swapChainImages.data());
+        // Rendered by the scene pass, blitted by the upscale
+        if (drs.enabled)
+        {
+            RenderTargetDesc desc;
+            desc.name       = "dynamic resolution";
+            desc.format     = mFormat;
+            desc.extent     = view.extent;
+            desc.usage      = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            desc.firstPass  = scenePass;
+            desc.lastPass   = scenePass + 1;
+            desc.consumed   = true;
+            desc.stages     = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_2_BLIT_BIT;
+            desc.access     = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_TRANSFER_READ_BIT;
+            view.internal   = renderTargets.add(desc);
+        }
+    }
 
-    // Get the extent and format
-    mExtent = extent;
-    mFormat = surfaceFormat.format;
+    renderTargets.build(device, physicalDevice);
 }
 
-SwapChainSupportDetails VKSetUp::querySwapChainSupport(const VkPhysicalDevice device) const
+SwapChainSupportDetails VKSetUp::querySwapChainSupport(const VkPhysicalDevice device, VkSurfaceKHR surface) const
 {
     SwapChainSupportDetails details;
 
@@ -441,10 +994,20 @@ QueueFamilyIndices VKSetUp::findQueueFamily(const VkPhysicalDevice& device) cons
     unsigned i = 0;
     for (const auto& queueFamily : queueFamilies)
     {
-        VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+        // All the views are presented at once, so the family has to present to every surface
+        VkBool32 presentSupport = true;
+        for (const auto& view : views)
+        {
+            VkBool32 surfaceSupport = VK_TRUE;
+            if (view.surface)
+                vkGetPhysicalDeviceSurfaceSupportKHR(device, i, view.surface, &surfaceSupport);
+
+            presentSupport = presentSupport && surfaceSupport;
+        }
 
-        if ((queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && presentSupport)
+        // Compute is needed by the meshlet culling and the compute batches
+        VkQueueFlags flags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+        if ((queueFamily.queueFlags & flags) == flags && presentSupport)
         {
             idx.graphicsFamily = i;
             idx.presentFamily  = i;
@@ -459,84 +1022,453 @@ QueueFamilyIndices VKSetUp::findQueueFamily(const VkPhysicalDevice& device) cons
     return idx;
 }
 
-void VKSetUp::recordCommandBuffer(uint32_t imgIdx)
+void VKSetUp::recordCommandBuffer(RenderView& view)
 {
+    VkCommandBuffer cmd = view.commandBuffer;
+
+    // With dynamic resolution the scene goes to the internal target, at a scaled extent
+    CaptureImage renderImage = drs.enabled ? CaptureImage::ViewInternal : CaptureImage::ViewTarget;
+    VkExtent2D   extent      = view.extent;
+    if (drs.enabled)
+    {
+        extent.width    = std::max(1u, static_cast<uint32_t>(static_cast<float>(view.extent.width) * view.resolutionScale));
+        extent.height   = std::max(1u, static_cast<uint32_t>(static_cast<float>(view.extent.height) * view.resolutionScale));
+    }
+    view.renderExtent = extent;
+
     // Start recording
     VkCommandBufferBeginInfo beginInfo{};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    vkBeginCommandBuffer(cmd, &beginInfo);
+    record(FrameOp::BeginView, CmdBeginView{ view.index });
+
+    view.tracedPasses = 0;
+    if (traceGpu)
+    {
+        uint32_t passCount = static_cast<uint32_t>(GpuPass::Count);
+        vkCmdResetQueryPool(cmd, tracePool, view.index * passCount * 2, passCount * 2);
+    }
+
+    // GPU time of the scene, read back on the next use of the view
+    uint32_t firstQuery = view.index * 2;
+    if (drs.enabled)
+    {
+        cmdTimestamp(cmd, FrameOp::ResetTimestamps, { {}, firstQuery, 2 });
+        cmdTimestamp(cmd, FrameOp::WriteTimestamp, { VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, firstQuery, 1 });
+    }
+
+    // Compute culling has to happen outside of the rendering scope
+    if (meshletScene && renderPath == RenderPath::MeshletCompute)
+    {
+        traceGpuPass(cmd, view, GpuPass::Cull, false);
+        recordMeshletCulling(cmd, extent);
+        traceGpuPass(cmd, view, GpuPass::Cull, true);
+    }
 
-    // Before rendering, swap the swapchain to COLOR_ATTACHMENT_OPTIMAL
-    transitionImgLayout(imgIdx,
+    traceGpuPass(cmd, view, GpuPass::Scene, false);
+
+    // Before rendering, swap the target to COLOR_ATTACHMENT_OPTIMAL. A pooled target may share its memory
+    // with a target of an earlier view, which has to be done with it first
+    VkPipelineStageFlags2 colorWaitStages = 0;
+    VkAccessFlags2        colorWaitAccess = 0;
+    if (drs.enabled)
+    {
+        colorWaitStages = renderTargets.aliasStages(view.internal);
+        colorWaitAccess = renderTargets.aliasAccess(view.internal);
+    }
+    cmdImageBarrier(cmd, { view.index, renderImage,
         VK_IMAGE_LAYOUT_UNDEFINED,
         VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-        {},
-        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
-        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
+        colorWaitAccess,
+        VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT | colorWaitStages,
+        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT });
 
-    VkClearValue clear{};
-    clear.color = { 0.f, 0.f, 0.f, 0.f };
+    // Samples of the pass. The resolve writes the target like a color attachment, the barrier above covers it
+    if (view.msaaColor != NO_RENDER_TARGET)
+    {
+        cmdImageBarrier(cmd, { view.index, CaptureImage::ViewMsaa,
+            VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            renderTargets.aliasAccess(view.msaaColor),
+            VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT | renderTargets.aliasStages(view.msaaColor),
+            VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT });
+    }
 
-    VkRenderingAttachmentInfo attInfo{};
-    attInfo.sType       = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
-    attInfo.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-    attInfo.loadOp      = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    attInfo.storeOp     = VK_ATTACHMENT_STORE_OP_STORE;
-    attInfo.imageView   = SCImageView[imgIdx];
-    attInfo.clearValue  = clear;
+    if (view.depth != NO_RENDER_TARGET)
+    {
+        VkPipelineStageFlags2 depthStages = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+        cmdImageBarrier(cmd, { view.index, CaptureImage::ViewDepth,
+            VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+            renderTargets.aliasAccess(view.depth),
+            VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            depthStages | renderTargets.aliasStages(view.depth),
+            depthStages });
+    }
 
-    VkRenderingInfo renderInfo{};
+    // Start rendering
+    cmdBeginRendering(cmd, { view.index, renderImage, extent.width, extent.height });
+
+    if (meshletScene)
+        recordMeshletScene(cmd, extent);
+    else
+    {
+        cmdBindPipeline(cmd, { CapturePipeline::Triangle, static_cast<uint8_t>(shaderFeatures) });
+        cmdDraw(cmd, FrameOp::Draw, { 3 });
+    }
+
+    // Finish rendering. Windows present the image, headless views leave it ready to be copied out
+    cmdEndRendering(cmd);
+    traceGpuPass(cmd, view, GpuPass::Scene, true);
+
+    // Upscale the internal target to the output image
+    VkImageLayout         outLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    VkAccessFlags2        outAccess = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+    VkPipelineStageFlags2 outStage  = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+    if (drs.enabled)
+    {
+        cmdTimestamp(cmd, FrameOp::WriteTimestamp, { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, firstQuery + 1, 1 });
+
+        traceGpuPass(cmd, view, GpuPass::Upscale, false);
+        cmdImageBarrier(cmd, { view.index, CaptureImage::ViewInternal,
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+            VK_ACCESS_2_TRANSFER_READ_BIT,
+            VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_PIPELINE_STAGE_2_BLIT_BIT });
+
+        // The source stage chains with the acquire semaphore wait (see outputStage)
+        cmdImageBarrier(cmd, { view.index, CaptureImage::ViewTarget,
+            VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            {},
+            VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_BLIT_BIT,
+            VK_PIPELINE_STAGE_2_BLIT_BIT });
+
+        cmdBlit(cmd, { view.index, extent.width, extent.height });
+        traceGpuPass(cmd, view, GpuPass::Upscale, true);
+
+        outLayout   = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        outAccess   = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+        outStage    = VK_PIPELINE_STAGE_2_BLIT_BIT;
+    }
+
+    traceGpuPass(cmd, view, GpuPass::Output, false);
+    if (view.swapChain)
+    {
+        // The render finished semaphore is signaled at outStage, the transition has to finish before it
+        cmdImageBarrier(cmd, { view.index, CaptureImage::ViewTarget,
+            static_cast<uint32_t>(outLayout),
+            VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+            outAccess,
+            {},
+            outStage,
+            outStage });
+    }
+    else
+    {
+        cmdImageBarrier(cmd, { view.index, CaptureImage::ViewTarget,
+            static_cast<uint32_t>(outLayout),
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            outAccess,
+            VK_ACCESS_2_TRANSFER_READ_BIT,
+            outStage,
+            VK_PIPELINE_STAGE_2_TRANSFER_BIT });
+
+        if (view.readback.buffer)
+            cmdCopyToReadback(cmd, { view.index });
+    }
+    traceGpuPass(cmd, view, GpuPass::Output, true);
+
+    // Finish recording
+    record(FrameOp::EndView);
+    vkEndCommandBuffer(cmd);
+}
+
+#pragma region FRAME COMMANDS
+// Every command of a frame goes through these, so a capture can record it and a replay
+// can issue it again. Payloads only name engine resources, they're resolved here
+
+template <typename T>
+void VKSetUp::record(FrameOp op, const T& payload)
+{
+    if (recorder.isRecording())
+        recorder.write(op, payload);
+}
+
+void VKSetUp::record(FrameOp op)
+{
+    if (recorder.isRecording())
+        recorder.write(op);
+}
+
+VkImage VKSetUp::resolveImage(uint32_t viewIdx, CaptureImage image) const
+{
+    const RenderView& view = views.at(viewIdx);
+    switch (image)
+    {
+    case CaptureImage::ViewInternal:    return renderTargets.getImage(view.internal);
+    case CaptureImage::ViewDepth:       return renderTargets.getImage(view.depth);
+    case CaptureImage::ViewMsaa:        return renderTargets.getImage(view.msaaColor);
+    default:                            return view.images[view.imageIndex];
+    }
+}
+
+VkPipeline VKSetUp::resolvePipeline(CapturePipeline pipeline, uint32_t features)
+{
+    VkPipeline  handle = pipeline == CapturePipeline::Cull ? cullPipeline : nullptr;
+    VkPipeline* slot   = pipelineVariantSlot(pipeline, features);
+    if (slot)
+    {
+        // Variants no frame used yet are compiled now
+        compilePipelineVariant(pipeline, features, true);
+        handle = *slot;
+    }
+
+    if (!handle)
+        throw std::runtime_error("the frame uses a pipeline that wasn't created");
+
+    return handle;
+}
+
+void VKSetUp::cmdImageBarrier(VkCommandBuffer cmd, CmdImageBarrier barrier)
+{
+    record(FrameOp::ImageBarrier, barrier);
+
+    // Replaying a windowed capture headless: the image is left ready to be copied instead of presented
+    if (barrier.newLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR && !views.at(barrier.view).swapChain)
+    {
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.dstAccess = VK_ACCESS_2_TRANSFER_READ_BIT;
+        barrier.dstStage  = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+    }
+
+    transitionImgLayout(cmd, resolveImage(barrier.view, barrier.image),
+        static_cast<VkImageLayout>(barrier.oldLayout),
+        static_cast<VkImageLayout>(barrier.newLayout),
+        barrier.srcAccess,
+        barrier.dstAccess,
+        barrier.srcStage,
+        barrier.dstStage,
+        barrier.image == CaptureImage::ViewDepth ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT);
+}
+
+static void issueMemoryBarrier(VkCommandBuffer cmd, const CmdMemoryBarrier& barrier)
+{
+    VkMemoryBarrier2 memBarrier{};
+    memBarrier.sType            = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+    memBarrier.srcStageMask     = barrier.srcStage;
+    memBarrier.srcAccessMask    = barrier.srcAccess;
+    memBarrier.dstStageMask     = barrier.dstStage;
+    memBarrier.dstAccessMask    = barrier.dstAccess;
+
+    VkDependencyInfo depenInfo{};
+    depenInfo.sType                 = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    depenInfo.memoryBarrierCount    = 1;
+    depenInfo.pMemoryBarriers       = &memBarrier;
+
+    vkCmdPipelineBarrier2(cmd, &depenInfo);
+}
+
+void VKSetUp::cmdMemoryBarrier(VkCommandBuffer cmd, const CmdMemoryBarrier& barrier)
+{
+    record(FrameOp::MemoryBarrier, barrier);
+    issueMemoryBarrier(cmd, barrier);
+}
+
+void VKSetUp::cmdBeginRendering(VkCommandBuffer cmd, const CmdBeginRendering& begin)
+{
+    record(FrameOp::BeginRendering, begin);
+
+    const RenderView& view = views.at(begin.view);
+    VkExtent2D extent = { begin.width, begin.height };
+
+    VkClearValue clear{};
+    clear.color = { 0.f, 0.f, 0.f, 0.f };
+
+    bool internal = begin.image == CaptureImage::ViewInternal;
+
+    VkRenderingAttachmentInfo attInfo{};
+    attInfo.sType       = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    attInfo.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    attInfo.loadOp      = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attInfo.storeOp     = internal ? renderTargets.storeOp(view.internal) : VK_ATTACHMENT_STORE_OP_STORE;
+    attInfo.imageView   = internal ? renderTargets.getView(view.internal) : view.imageViews[view.imageIndex];
+    attInfo.clearValue  = clear;
+
+    // With multisampling the pass renders the samples, and averages them into the target when it ends
+    if (view.msaaColor != NO_RENDER_TARGET)
+    {
+        attInfo.resolveMode         = VK_RESOLVE_MODE_AVERAGE_BIT;
+        attInfo.resolveImageView    = attInfo.imageView;
+        attInfo.resolveImageLayout  = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        attInfo.imageView           = renderTargets.getView(view.msaaColor);
+        attInfo.storeOp             = renderTargets.storeOp(view.msaaColor);
+    }
+
+    // The depth is never stored, on a tiler it never leaves the tile memory
+    VkRenderingAttachmentInfo depthInfo{};
+    if (view.depth != NO_RENDER_TARGET)
+    {
+        depthInfo.sType                     = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        depthInfo.imageLayout               = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL;
+        depthInfo.loadOp                    = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        depthInfo.storeOp                   = renderTargets.storeOp(view.depth);
+        depthInfo.imageView                 = renderTargets.getView(view.depth);
+        depthInfo.clearValue.depthStencil   = { 1.f, 0 };
+    }
+
+    VkRenderingInfo renderInfo{};
     renderInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
-    renderInfo.renderArea = { .offset = {0, 0}, .extent = mExtent };
+    renderInfo.renderArea = { .offset = {0, 0}, .extent = extent };
     renderInfo.layerCount = 1;
     renderInfo.colorAttachmentCount = 1;
     renderInfo.pColorAttachments = &attInfo;
+    renderInfo.pDepthAttachment = view.depth != NO_RENDER_TARGET ? &depthInfo : nullptr;
 
-    // Start rendering
-    vkCmdBeginRendering(commandBuffer, &renderInfo);
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+    vkCmdBeginRendering(cmd, &renderInfo);
 
     VkViewport vp{};
     vp.x = 0.f;
     vp.y = 0.f;
     vp.minDepth = 0.f;
     vp.maxDepth = 1.f;
-    vp.width = static_cast<float>(mExtent.width);
-    vp.height = static_cast<float>(mExtent.height);
-    vkCmdSetViewport(commandBuffer, 0, 1, &vp);
+    vp.width = static_cast<float>(extent.width);
+    vp.height = static_cast<float>(extent.height);
+    vkCmdSetViewport(cmd, 0, 1, &vp);
 
     VkRect2D rect{};
     rect.offset = VkOffset2D(0, 0);
-    rect.extent = mExtent;
-    vkCmdSetScissor(commandBuffer, 0, 1, &rect);
+    rect.extent = extent;
+    vkCmdSetScissor(cmd, 0, 1, &rect);
+}
 
-    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+void VKSetUp::cmdEndRendering(VkCommandBuffer cmd)
+{
+    record(FrameOp::EndRendering);
+    vkCmdEndRendering(cmd);
+}
 
-    // Finish rendering
-    vkCmdEndRendering(commandBuffer);
-    transitionImgLayout(imgIdx,
-        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-        VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
-        {},
-        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
-        VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT);
-    
-    // Finish recording
-    vkEndCommandBuffer(commandBuffer);
+void VKSetUp::cmdBindPipeline(VkCommandBuffer cmd, const CmdBindPipeline& bind)
+{
+    record(FrameOp::BindPipeline, bind);
+
+    VkPipelineBindPoint bindPoint = bind.pipeline == CapturePipeline::Cull ? VK_PIPELINE_BIND_POINT_COMPUTE : VK_PIPELINE_BIND_POINT_GRAPHICS;
+    vkCmdBindPipeline(cmd, bindPoint, resolvePipeline(bind.pipeline, bind.features));
+}
+
+void VKSetUp::cmdBindMeshletSet(VkCommandBuffer cmd, const CmdBindPipeline& bind)
+{
+    record(FrameOp::BindMeshletSet, bind);
+
+    VkPipelineBindPoint bindPoint = bind.pipeline == CapturePipeline::Cull ? VK_PIPELINE_BIND_POINT_COMPUTE : VK_PIPELINE_BIND_POINT_GRAPHICS;
+    vkCmdBindDescriptorSets(cmd, bindPoint, meshLayout, 0, 1, &meshletSet, 0, nullptr);
+}
+
+void VKSetUp::cmdBindMeshBuffers(VkCommandBuffer cmd)
+{
+    record(FrameOp::BindMeshBuffers);
+
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(cmd, 0, 1, &vertexBuffer.buffer, &offset);
+    vkCmdBindIndexBuffer(cmd, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+}
+
+void VKSetUp::cmdPushConstants(VkCommandBuffer cmd, const MeshPushConstants& pc)
+{
+    record(FrameOp::PushConstants, pc);
+    vkCmdPushConstants(cmd, meshLayout, VK_SHADER_STAGE_VERTEX_BIT | meshletStages(), 0, sizeof(pc), &pc);
+}
+
+void VKSetUp::cmdDraw(VkCommandBuffer cmd, FrameOp op, const CmdDraw& draw)
+{
+    record(op, draw);
+
+    switch (op)
+    {
+    case FrameOp::Draw:             vkCmdDraw(cmd, draw.count, 1, 0, 0); break;
+    case FrameOp::DrawIndexed:      vkCmdDrawIndexed(cmd, draw.count, 1, 0, 0, 0); break;
+    case FrameOp::DrawIndirect:     vkCmdDrawIndirect(cmd, indirectBuffer.buffer, 0, draw.count, sizeof(VkDrawIndirectCommand)); break;
+    case FrameOp::Dispatch:         vkCmdDispatch(cmd, draw.count, 1, 1); break;
+    case FrameOp::DrawMeshTasks:
+        if (!pfnCmdDrawMeshTasks)
+            throw std::runtime_error("the frame draws mesh tasks but mesh shaders aren't enabled");
+        pfnCmdDrawMeshTasks(cmd, draw.count, 1, 1);
+        break;
+    default:
+        throw std::runtime_error("not a draw command");
+    }
+}
+
+void VKSetUp::cmdTimestamp(VkCommandBuffer cmd, FrameOp op, const CmdTimestamp& timestamp)
+{
+    record(op, timestamp);
+
+    // A replay doesn't always measure
+    if (!timestampPool)
+        return;
+
+    if (op == FrameOp::ResetTimestamps)
+        vkCmdResetQueryPool(cmd, timestampPool, timestamp.query, timestamp.count);
+    else
+        vkCmdWriteTimestamp2(cmd, timestamp.stage, timestampPool, timestamp.query);
+}
+
+void VKSetUp::cmdBlit(VkCommandBuffer cmd, const CmdBlit& blitCmd)
+{
+    record(FrameOp::Blit, blitCmd);
+
+    const RenderView& view = views.at(blitCmd.view);
+
+    VkImageBlit blit{};
+    blit.srcSubresource.aspectMask  = VK_IMAGE_ASPECT_COLOR_BIT;
+    blit.srcSubresource.layerCount  = 1;
+    blit.srcOffsets[1]              = { static_cast<int32_t>(blitCmd.srcWidth), static_cast<int32_t>(blitCmd.srcHeight), 1 };
+    blit.dstSubresource.aspectMask  = VK_IMAGE_ASPECT_COLOR_BIT;
+    blit.dstSubresource.layerCount  = 1;
+    blit.dstOffsets[1]              = { static_cast<int32_t>(view.extent.width), static_cast<int32_t>(view.extent.height), 1 };
+
+    vkCmdBlitImage(cmd,
+        renderTargets.getImage(view.internal), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        view.images[view.imageIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        1, &blit, VK_FILTER_LINEAR);
 }
 
-void VKSetUp::transitionImgLayout(uint32_t imgIdx,
+void VKSetUp::cmdCopyToReadback(VkCommandBuffer cmd, const CmdBeginView& copy)
+{
+    record(FrameOp::CopyToReadback, copy);
+
+    const RenderView& view = views.at(copy.view);
+    if (!view.readback.buffer)
+        return;
+
+    VkBufferImageCopy region{};
+    region.imageSubresource.aspectMask  = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount  = 1;
+    region.imageExtent                  = { view.extent.width, view.extent.height, 1 };
+    vkCmdCopyImageToBuffer(cmd, view.images[view.imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, view.readback.buffer, 1, &region);
+
+    // Make the copy visible to the host once the fence is signaled. Part of the copy, not recorded on its own
+    issueMemoryBarrier(cmd, { VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_2_HOST_BIT, VK_ACCESS_2_HOST_READ_BIT });
+}
+#pragma endregion
+
+void VKSetUp::transitionImgLayout(VkCommandBuffer cmd,
+    VkImage image,
     VkImageLayout oldLayout,
     VkImageLayout newLayout,
     VkAccessFlags2 srcAM,
     VkAccessFlags2 dstAM,
     VkPipelineStageFlags2 srcSM,
-    VkPipelineStageFlags2 dstSM)
+    VkPipelineStageFlags2 dstSM,
+    VkImageAspectFlags aspect)
 {
     VkImageSubresourceRange subRange{};
-    subRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+    subRange.aspectMask     = aspect;
     subRange.baseMipLevel   = 0;
     subRange.levelCount     = 1;
     subRange.baseArrayLayer = 0;
@@ -552,7 +1484,7 @@ void VKSetUp::transitionImgLayout(uint32_t imgIdx,
     barrier.newLayout           = newLayout;
     barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
     barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.image               = swapChainImages[imgIdx];
+    barrier.image               = image;
     barrier.subresourceRange    = subRange;
 
     VkDependencyInfo depenInfo{};
@@ -561,41 +1493,53 @@ void VKSetUp::transitionImgLayout(uint32_t imgIdx,
     depenInfo.imageMemoryBarrierCount = 1;
     depenInfo.pImageMemoryBarriers    = &barrier;
 
-    vkCmdPipelineBarrier2(commandBuffer, &depenInfo);
+    vkCmdPipelineBarrier2(cmd, &depenInfo);
 }
 
 void VKSetUp::destroyDebugMessenger() const
 {
-    DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
+    if (!debugMessenger)
+        return;
+
+    ResourceTracker::destroyed(VK_OBJECT_TYPE_DEBUG_UTILS_MESSENGER_EXT, debugMessenger);
+    DestroyDebugUtilsMessengerEXT(instance, debugMessenger, ResourceTracker::allocator());
 }
 
 void VKSetUp::createImageViews()
 {
-    SCImageView.resize(swapChainImages.size());
-
-    int size = static_cast<int>(swapChainImages.size());
-    for (int i = 0; i < size; i++)
+    for (auto& view : views)
     {
-        VkImageViewCreateInfo createInfo{};
-        createInfo.sType    = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-        createInfo.image    = swapChainImages[i];
-        createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D; // The type of texture that it will be storing the data (1D, 2D or 3D textures)
-        createInfo.format   = mFormat;
-
-        createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-        createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-        createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-        createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+        // Headless views got theirs with the offscreen image
+        if (!view.swapChain)
+            continue;
 
-        // The type of texture that it will output to the window (all colors, black & white, ...)
-        createInfo.subresourceRange.aspectMask      = VK_IMAGE_ASPECT_COLOR_BIT; 
-        createInfo.subresourceRange.baseMipLevel    = 0;
-        createInfo.subresourceRange.levelCount      = 1;
-        createInfo.subresourceRange.baseArrayLayer  = 0;
-        createInfo.subresourceRange.layerCount      = 1;
+        view.imageViews.resize(view.images.size());
 
-        if (vkCreateImageView(device, &createInfo, nullptr, &SCImageView.at(i)) != VK_SUCCESS)
-            throw std::runtime_error("Failed to create image views! (a.k.a textures)");
+        int size = static_cast<int>(view.images.size());
+        for (int i = 0; i < size; i++)
+        {
+            VkImageViewCreateInfo createInfo{};
+            createInfo.sType    = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            createInfo.image    = view.images[i];
+            createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D; // The type of texture that it will be storing the data (1D, 2D or 3D textures)
+            createInfo.format   = mFormat;
+
+            createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+            createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+            createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+            createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+
+            // The type of texture that it will output to the window (all colors, black & white, ...)
+            createInfo.subresourceRange.aspectMask      = VK_IMAGE_ASPECT_COLOR_BIT;
+            createInfo.subresourceRange.baseMipLevel    = 0;
+            createInfo.subresourceRange.levelCount      = 1;
+            createInfo.subresourceRange.baseArrayLayer  = 0;
+            createInfo.subresourceRange.layerCount      = 1;
+
+            if (vkCreateImageView(device, &createInfo, ResourceTracker::allocator(), &view.imageViews.at(i)) != VK_SUCCESS)
+                throw std::runtime_error("Failed to create image views! (a.k.a textures)");
+            ResourceTracker::created(VK_OBJECT_TYPE_IMAGE_VIEW, view.imageViews.at(i));
+        }
     }
 }
 
@@ -604,7 +1548,7 @@ static std::vector<char> readFile(const std::string& filename)
     std::ifstream file(filename, std::ios::ate | std::ios::binary);
 
     if (!file.is_open())
-        throw std::runtime_error("failed to open file!");
+        throw std::runtime_error("failed to open file " + filename);
 
     size_t fileSize = static_cast<size_t>(file.tellg());
     std::vector<char> buffer(fileSize);
@@ -616,18 +1560,49 @@ static std::vector<char> readFile(const std::string& filename)
     return buffer;
 }
 
+VkShaderModule VKSetUp::loadShaderModule(const std::string& path) const
+{
+    return createShaderModule(readFile(path));
+}
+
 void VKSetUp::createGraphicsPipeline()
 {
+    selectFormats();
+
 #pragma region SHADER
-    // read SPIR-V shader code. To generate .spv files, go to 
-    // "data/shaders/compile.bat" and double-click it.
-    auto vertShad = readFile("../data/shaders/vert.spv");
-    auto fragShad = readFile("../data/shaders/frag.spv");
+    // read SPIR-V shader code. The build compiles "data/shaders" into SHADER_DIR
+    auto vertShad = readFile(SHADER_DIR "vert.spv");
+    auto fragShad = readFile(SHADER_DIR "frag.spv");
+
+    // Every pipeline variant is specialized from this module, a stale one would make them all the same
+    if (!declaresFeatures<FragShader>(reinterpret_cast<const uint32_t*>(fragShad.data()), fragShad.size() / sizeof(uint32_t)))
+        throw std::runtime_error("frag.spv doesn't declare the shader feature constants, rebuild the shaders");
 
     // create the modules for the vertex and fragment shaders
     vShadMod = createShaderModule(vertShad);
     fShadMod = createShaderModule(fragShad);
 
+    // Pipeline layout (a.k.a. uniforms for shaders)
+    VkPipelineLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.setLayoutCount = 0;
+    layoutInfo.pushConstantRangeCount = 0;
+
+    if (vkCreatePipelineLayout(device, &layoutInfo, ResourceTracker::allocator(), &layout) != VK_SUCCESS)
+        throw std::runtime_error("failed to create the pipeline layout");
+    ResourceTracker::created(VK_OBJECT_TYPE_PIPELINE_LAYOUT, layout);
+#pragma endregion
+
+    // The meshlet scene replaces the triangle, it's only compiled if a frame asks for it
+    if (!meshletScene)
+        compilePipelineVariant(CapturePipeline::Triangle, shaderFeatures, false);
+}
+
+VkPipeline VKSetUp::buildTrianglePipeline(uint32_t variant)
+{
+    Specialization<FragShader> specialization(variant);
+    VkSpecializationInfo       specializationInfo = specialization.info();
+
     // create shader stages to actually use the shaders
     VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
     vertShaderStageInfo.sType   = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -640,20 +1615,35 @@ void VKSetUp::createGraphicsPipeline()
     fragShaderStageInfo.stage   = VK_SHADER_STAGE_FRAGMENT_BIT;
     fragShaderStageInfo.module  = fShadMod;
     fragShaderStageInfo.pName   = "main";
+    fragShaderStageInfo.pSpecializationInfo = &specializationInfo;
 
     VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
-#pragma endregion
 
+    // Describes the format of the vtx data to pass into the vtx shader (a.k.a. VAO and VBO).
+    // For now, do nothing...
+    VkPipelineVertexInputStateCreateInfo vtxInputInfo{};
+    vtxInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+    // Final sewt up for the graphics set up
+    return buildGraphicsPipeline(shaderStages, 2, &vtxInputInfo, VK_FRONT_FACE_CLOCKWISE, layout);
+}
+
+VkPipeline VKSetUp::buildGraphicsPipeline(const VkPipelineShaderStageCreateInfo* stages,
+    uint32_t stageCount,
+    const VkPipelineVertexInputStateCreateInfo* vtxInput,
+    VkFrontFace frontFace,
+    VkPipelineLayout pipeLayout,
+    bool depthTest) const
+{
     std::vector dynamicStates   = { VkDynamicState::VK_DYNAMIC_STATE_VIEWPORT, VkDynamicState::VK_DYNAMIC_STATE_SCISSOR };
     VkPipelineDynamicStateCreateInfo dynState{};
     dynState.sType              = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
     dynState.dynamicStateCount  = static_cast<uint32_t>(dynamicStates.size());
     dynState.pDynamicStates     = dynamicStates.data();
 
-    // Describes the format of the vtx data to pass into the vtx shader (a.k.a. VAO and VBO).
-    // For now, do nothing...
-    VkPipelineVertexInputStateCreateInfo vtxInputInfo{};
-    vtxInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    // Mesh shading pipelines have no vertex input nor input assembly
+    bool meshShading = std::any_of(stages, stages + stageCount, [](const VkPipelineShaderStageCreateInfo& stage)
+        { return stage.stage == VK_SHADER_STAGE_MESH_BIT_EXT; });
 
     VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
     inputAssembly.sType     = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -671,7 +1661,7 @@ void VKSetUp::createGraphicsPipeline()
     rasterizer.rasterizerDiscardEnable  = VK_FALSE;
     rasterizer.polygonMode              = VK_POLYGON_MODE_FILL;
     rasterizer.cullMode                 = VK_CULL_MODE_BACK_BIT;
-    rasterizer.frontFace                = VK_FRONT_FACE_CLOCKWISE;
+    rasterizer.frontFace                = frontFace;
     rasterizer.depthBiasEnable          = VK_FALSE;
     rasterizer.depthBiasSlopeFactor     = 1.f;
     rasterizer.lineWidth                = 1.f;
@@ -679,12 +1669,15 @@ void VKSetUp::createGraphicsPipeline()
     // Multisaplimg
     VkPipelineMultisampleStateCreateInfo multi{};
     multi.sType                 = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    multi.rasterizationSamples  = VK_SAMPLE_COUNT_1_BIT;
+    multi.rasterizationSamples  = msaaSamples;
     multi.sampleShadingEnable   = VK_FALSE;
 
-    // Depth and stencil (do nothing for now...)
+    // Depth and stencil
     VkPipelineDepthStencilStateCreateInfo depth{};
-    depth.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depth.sType             = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depth.depthTestEnable   = depthTest;
+    depth.depthWriteEnable  = depthTest;
+    depth.depthCompareOp    = VK_COMPARE_OP_LESS;
 
     // Color blending
     VkPipelineColorBlendAttachmentState colBlendAtt{};
@@ -717,38 +1710,34 @@ void VKSetUp::createGraphicsPipeline()
     colorBlend.attachmentCount  = 1;
     colorBlend.pAttachments     = &colBlendAtt;
 
-    // Pipeline layout (a.k.a. uniforms for shaders)
-    VkPipelineLayoutCreateInfo layoutInfo{};
-    layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    layoutInfo.setLayoutCount = 0;
-    layoutInfo.pushConstantRangeCount = 0;
-
-    if (vkCreatePipelineLayout(device, &layoutInfo, nullptr, &layout) != VK_SUCCESS)
-        throw std::runtime_error("failed to create the pipeline layout");
-
-    // Final sewt up for the graphics set up
     VkPipelineRenderingCreateInfo renderingInfo{};
     renderingInfo.sType                     = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
     renderingInfo.colorAttachmentCount      = 1;
     renderingInfo.pColorAttachmentFormats   = &mFormat;
+    renderingInfo.depthAttachmentFormat     = depthTest ? depthFormat : VK_FORMAT_UNDEFINED;
 
     VkGraphicsPipelineCreateInfo pipeInfo{};
     pipeInfo.sType                  = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
     pipeInfo.pNext                  = &renderingInfo;
-    pipeInfo.stageCount             = 2;
-    pipeInfo.pStages                = shaderStages;
-    pipeInfo.pVertexInputState      = &vtxInputInfo;
-    pipeInfo.pInputAssemblyState    = &inputAssembly;
+    pipeInfo.stageCount             = stageCount;
+    pipeInfo.pStages                = stages;
+    pipeInfo.pVertexInputState      = meshShading ? nullptr : vtxInput;
+    pipeInfo.pInputAssemblyState    = meshShading ? nullptr : &inputAssembly;
     pipeInfo.pViewportState         = &vpState;
     pipeInfo.pRasterizationState    = &rasterizer;
     pipeInfo.pMultisampleState      = &multi;
+    pipeInfo.pDepthStencilState     = &depth;
     pipeInfo.pColorBlendState       = &colorBlend;
     pipeInfo.pDynamicState          = &dynState;
-    pipeInfo.layout                 = layout;
+    pipeInfo.layout                 = pipeLayout;
     pipeInfo.renderPass             = nullptr;
 
-    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
+    VkPipeline pipeline;
+    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeInfo, ResourceTracker::allocator(), &pipeline) != VK_SUCCESS)
         throw std::runtime_error("could not create the graphics pipeline");
+    ResourceTracker::created(VK_OBJECT_TYPE_PIPELINE, pipeline);
+
+    return pipeline;
 }
 
 void VKSetUp::createCommandPool()
@@ -756,22 +1745,29 @@ void VKSetUp::createCommandPool()
     VkCommandPoolCreateInfo poolInfo{};
     poolInfo.sType              = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
     poolInfo.flags              = VkCommandPoolCreateFlagBits::VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-    poolInfo.queueFamilyIndex   = findQueueFamily(physicalDevice).graphicsFamily.value();
+    poolInfo.queueFamilyIndex   = queueFamilies.graphicsFamily.value();
 
-    if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
+    if (vkCreateCommandPool(device, &poolInfo, ResourceTracker::allocator(), &commandPool) != VK_SUCCESS)
         throw std::runtime_error("Could not create command pool");
+    ResourceTracker::created(VK_OBJECT_TYPE_COMMAND_POOL, commandPool);
 }
 
 void VKSetUp::createCommandBuffer()
 {
+    // One per view, they are all recorded every frame
+    std::vector<VkCommandBuffer> commandBuffers(views.size());
+
     VkCommandBufferAllocateInfo allocInfo{};
     allocInfo.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     allocInfo.commandPool        = commandPool;
     allocInfo.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandBufferCount = 1;
+    allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
 
-    if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS)
+    if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS)
         throw std::runtime_error("Could not allocate the command buffer");
+
+    for (size_t i = 0; i < views.size(); i++)
+        views[i].commandBuffer = commandBuffers[i];
 }
 
 void VKSetUp::createSyncObjs()
@@ -783,68 +1779,1069 @@ void VKSetUp::createSyncObjs()
     fCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
     fCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-    vkCreateSemaphore(device, &sCreateInfo, nullptr, &presentComplete);
-    vkCreateSemaphore(device, &sCreateInfo, nullptr, &renderFinished);
-    vkCreateFence(device, &fCreateInfo, nullptr, &drawFence);
+    vkCreateFence(device, &fCreateInfo, ResourceTracker::allocator(), &drawFence);
+    ResourceTracker::created(VK_OBJECT_TYPE_FENCE, drawFence);
+
+    // The present of a swap chain image can't be tracked, so each image gets its own render finished semaphore
+    for (auto& view : views)
+    {
+        if (!view.swapChain)
+            continue;
+
+        vkCreateSemaphore(device, &sCreateInfo, ResourceTracker::allocator(), &view.imageAvailable);
+        ResourceTracker::created(VK_OBJECT_TYPE_SEMAPHORE, view.imageAvailable);
+
+        view.renderFinished.resize(view.images.size());
+        for (auto& semaphore : view.renderFinished)
+        {
+            vkCreateSemaphore(device, &sCreateInfo, ResourceTracker::allocator(), &semaphore);
+            ResourceTracker::created(VK_OBJECT_TYPE_SEMAPHORE, semaphore);
+        }
+    }
+
+    // Two timestamps per view for the dynamic resolution
+    if (drs.enabled)
+    {
+        VkQueryPoolCreateInfo queryInfo{};
+        queryInfo.sType         = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryInfo.queryType     = VK_QUERY_TYPE_TIMESTAMP;
+        queryInfo.queryCount    = static_cast<uint32_t>(views.size()) * 2;
+
+        if (vkCreateQueryPool(device, &queryInfo, ResourceTracker::allocator(), &timestampPool) != VK_SUCCESS)
+            throw std::runtime_error("failed to create the timestamp query pool");
+        ResourceTracker::created(VK_OBJECT_TYPE_QUERY_POOL, timestampPool);
+    }
+
+    // GPU ranges of the trace. Created even when tracing is off, it can be turned on at any time
+    if (capabilities.timestamps)
+    {
+        VkQueryPoolCreateInfo queryInfo{};
+        queryInfo.sType         = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryInfo.queryType     = VK_QUERY_TYPE_TIMESTAMP;
+        queryInfo.queryCount    = static_cast<uint32_t>(views.size() * static_cast<size_t>(GpuPass::Count) * 2);
+
+        if (vkCreateQueryPool(device, &queryInfo, ResourceTracker::allocator(), &tracePool) != VK_SUCCESS)
+            throw std::runtime_error("failed to create the trace query pool");
+        ResourceTracker::created(VK_OBJECT_TYPE_QUERY_POOL, tracePool);
+
+        for (auto& view : views)
+            view.gpuTrack = Trace::createTrack("GPU " + capabilities.name + ", view " + std::to_string(view.index));
+    }
+}
+
+#pragma region BUFFER HELPERS
+uint32_t VKSetUp::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags props) const
+{
+    VkPhysicalDeviceMemoryProperties memProps;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProps);
+
+    for (uint32_t i = 0; i < memProps.memoryTypeCount; i++)
+    {
+        if ((typeFilter & (1u << i)) && (memProps.memoryTypes[i].propertyFlags & props) == props)
+            return i;
+    }
+
+    throw std::runtime_error("failed to find a suitable memory type!");
+}
+
+GpuBuffer VKSetUp::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags props) const
+{
+    GpuBuffer buffer;
+    buffer.size = size;
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType        = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size         = size;
+    bufferInfo.usage        = usage;
+    bufferInfo.sharingMode  = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(device, &bufferInfo, ResourceTracker::allocator(), &buffer.buffer) != VK_SUCCESS)
+        throw std::runtime_error("failed to create buffer!");
+    ResourceTracker::created(VK_OBJECT_TYPE_BUFFER, buffer.buffer);
+
+    VkMemoryRequirements memReq;
+    vkGetBufferMemoryRequirements(device, buffer.buffer, &memReq);
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType             = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize    = memReq.size;
+    allocInfo.memoryTypeIndex   = findMemoryType(memReq.memoryTypeBits, props);
+
+    if (vkAllocateMemory(device, &allocInfo, ResourceTracker::allocator(), &buffer.memory) != VK_SUCCESS)
+        throw std::runtime_error("failed to allocate buffer memory!");
+    ResourceTracker::allocated(buffer.memory, allocInfo.allocationSize);
+
+    vkBindBufferMemory(device, buffer.buffer, buffer.memory, 0);
+
+    return buffer;
 }
 
+GpuBuffer VKSetUp::createDeviceLocalBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage)
+{
+    // Upload through a host visible staging buffer
+    GpuBuffer staging = createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    void* mapped;
+    vkMapMemory(device, staging.memory, 0, size, 0, &mapped);
+    memcpy(mapped, data, static_cast<size_t>(size));
+    vkUnmapMemory(device, staging.memory);
+
+    GpuBuffer buffer = createBuffer(size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    // Kept for the frame captures, a replay checks it rebuilt the same scene
+    uploads.push_back({ static_cast<uint64_t>(size), hashBytes(data, static_cast<size_t>(size)) });
+
+    VkCommandBuffer cmd = beginSingleTimeCommands();
+    VkBufferCopy region{};
+    region.size = size;
+    vkCmdCopyBuffer(cmd, staging.buffer, buffer.buffer, 1, &region);
+    endSingleTimeCommands(cmd);
+
+    destroyBuffer(staging);
+
+    return buffer;
+}
+
+void VKSetUp::destroyBuffer(GpuBuffer& buffer) const
+{
+    ResourceTracker::destroyed(VK_OBJECT_TYPE_BUFFER, buffer.buffer);
+    vkDestroyBuffer(device, buffer.buffer, ResourceTracker::allocator());
+    ResourceTracker::freed(buffer.memory);
+    vkFreeMemory(device, buffer.memory, ResourceTracker::allocator());
+    buffer = {};
+}
+
+GpuImage VKSetUp::createImage(VkExtent2D extent, VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect) const
+{
+    GpuImage image;
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType     = VK_IMAGE_TYPE_2D;
+    imageInfo.format        = format;
+    imageInfo.extent        = { extent.width, extent.height, 1 };
+    imageInfo.mipLevels     = 1;
+    imageInfo.arrayLayers   = 1;
+    imageInfo.samples       = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling        = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage         = usage;
+    imageInfo.sharingMode   = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    if (vkCreateImage(device, &imageInfo, ResourceTracker::allocator(), &image.image) != VK_SUCCESS)
+        throw std::runtime_error("failed to create image!");
+    ResourceTracker::created(VK_OBJECT_TYPE_IMAGE, image.image);
+
+    VkMemoryRequirements memReq;
+    vkGetImageMemoryRequirements(device, image.image, &memReq);
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType             = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize    = memReq.size;
+    allocInfo.memoryTypeIndex   = findMemoryType(memReq.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    if (vkAllocateMemory(device, &allocInfo, ResourceTracker::allocator(), &image.memory) != VK_SUCCESS)
+        throw std::runtime_error("failed to allocate image memory!");
+    ResourceTracker::allocated(image.memory, allocInfo.allocationSize);
+
+    vkBindImageMemory(device, image.image, image.memory, 0);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType                              = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image                              = image.image;
+    viewInfo.viewType                           = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format                             = format;
+    viewInfo.subresourceRange.aspectMask        = aspect;
+    viewInfo.subresourceRange.baseMipLevel      = 0;
+    viewInfo.subresourceRange.levelCount        = 1;
+    viewInfo.subresourceRange.baseArrayLayer    = 0;
+    viewInfo.subresourceRange.layerCount        = 1;
+
+    if (vkCreateImageView(device, &viewInfo, ResourceTracker::allocator(), &image.view) != VK_SUCCESS)
+        throw std::runtime_error("failed to create image view!");
+    ResourceTracker::created(VK_OBJECT_TYPE_IMAGE_VIEW, image.view);
+
+    return image;
+}
+
+void VKSetUp::destroyImage(GpuImage& image) const
+{
+    ResourceTracker::destroyed(VK_OBJECT_TYPE_IMAGE_VIEW, image.view);
+    vkDestroyImageView(device, image.view, ResourceTracker::allocator());
+    ResourceTracker::destroyed(VK_OBJECT_TYPE_IMAGE, image.image);
+    vkDestroyImage(device, image.image, ResourceTracker::allocator());
+    ResourceTracker::freed(image.memory);
+    vkFreeMemory(device, image.memory, ResourceTracker::allocator());
+    image = {};
+}
+
+VkCommandBuffer VKSetUp::beginSingleTimeCommands() const
+{
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool        = commandPool;
+    allocInfo.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+
+    VkCommandBuffer cmd;
+    if (vkAllocateCommandBuffers(device, &allocInfo, &cmd) != VK_SUCCESS)
+        throw std::runtime_error("Could not allocate the command buffer");
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(cmd, &beginInfo);
+
+    return cmd;
+}
+
+void VKSetUp::endSingleTimeCommands(VkCommandBuffer cmd) const
+{
+    vkEndCommandBuffer(cmd);
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount   = 1;
+    submitInfo.pCommandBuffers      = &cmd;
+
+    vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+    vkQueueWaitIdle(graphicsQueue);
+
+    vkFreeCommandBuffers(device, commandPool, 1, &cmd);
+}
+#pragma endregion
+
+#pragma region MESHLET SCENE
+// Vertices, meshlets, bounds, meshlet vertices, meshlet triangles, indirect commands
+static constexpr uint32_t MESHLET_BINDING_COUNT = 6;
+
+static VkPipelineShaderStageCreateInfo shaderStageInfo(VkShaderStageFlagBits stage, VkShaderModule module,
+    const VkSpecializationInfo* specialization = nullptr)
+{
+    VkPipelineShaderStageCreateInfo info{};
+    info.sType                  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    info.stage                  = stage;
+    info.module                 = module;
+    info.pName                  = "main";
+    info.pSpecializationInfo    = specialization;
+
+    return info;
+}
+
+VkShaderStageFlags VKSetUp::meshletStages() const
+{
+    if (meshletPath == RenderPath::MeshletTask)
+        return VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
+
+    return VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+}
+
+void VKSetUp::prepareMeshletScene()
+{
+    if (!meshletScene || !sceneIndices.empty())
+        return;
+
+    // Test geometry, dense enough for the per meshlet culling to matter. CPU only, it can
+    // run before the device exists
+    generateSphere(256, 512, 1.f, sceneVertices, sceneIndices);
+    sceneMesh = buildMeshlets(sceneVertices, sceneIndices);
+}
+
+void VKSetUp::createMeshletPipelines()
+{
+    if (!meshletScene || meshLayout)
+        return;
+
+    selectFormats();
+
+    VkDescriptorSetLayoutBinding bindings[MESHLET_BINDING_COUNT]{};
+    for (uint32_t i = 0; i < MESHLET_BINDING_COUNT; i++)
+    {
+        bindings[i].binding         = i;
+        bindings[i].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags      = meshletStages();
+    }
+
+    VkDescriptorSetLayoutCreateInfo setLayoutInfo{};
+    setLayoutInfo.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setLayoutInfo.bindingCount  = MESHLET_BINDING_COUNT;
+    setLayoutInfo.pBindings     = bindings;
+
+    if (vkCreateDescriptorSetLayout(device, &setLayoutInfo, ResourceTracker::allocator(), &meshletSetLayout) != VK_SUCCESS)
+        throw std::runtime_error("failed to create the meshlet descriptor set layout");
+    ResourceTracker::created(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT, meshletSetLayout);
+
+    // The same push constants feed every stage of every path
+    VkPushConstantRange pushRange{};
+    pushRange.stageFlags    = VK_SHADER_STAGE_VERTEX_BIT | meshletStages();
+    pushRange.offset        = 0;
+    pushRange.size          = sizeof(MeshPushConstants);
+
+    VkPipelineLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType                    = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.setLayoutCount           = 1;
+    layoutInfo.pSetLayouts              = &meshletSetLayout;
+    layoutInfo.pushConstantRangeCount   = 1;
+    layoutInfo.pPushConstantRanges      = &pushRange;
+
+    if (vkCreatePipelineLayout(device, &layoutInfo, ResourceTracker::allocator(), &meshLayout) != VK_SUCCESS)
+        throw std::runtime_error("failed to create the meshlet pipeline layout");
+    ResourceTracker::created(VK_OBJECT_TYPE_PIPELINE_LAYOUT, meshLayout);
+
+    // Only the variants of the path that draws are compiled up front, the classic path is the reference
+    // but doesn't draw unless the device has no meshlet path
+    if (renderPath == RenderPath::Classic)
+        compilePipelineVariant(CapturePipeline::Classic, shaderFeatures, false);
+    if (meshletPath != RenderPath::Classic)
+        compilePipelineVariant(CapturePipeline::Meshlet, shaderFeatures, false);
+
+    if (meshletPath == RenderPath::MeshletCompute)
+    {
+        VkComputePipelineCreateInfo computeInfo{};
+        computeInfo.sType   = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        computeInfo.stage   = shaderStageInfo(VK_SHADER_STAGE_COMPUTE_BIT, cachedShaderModule(SHADER_DIR "meshlet_cull.spv"));
+        computeInfo.layout  = meshLayout;
+
+        if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &computeInfo, ResourceTracker::allocator(), &cullPipeline) != VK_SUCCESS)
+            throw std::runtime_error("could not create the meshlet culling pipeline");
+        ResourceTracker::created(VK_OBJECT_TYPE_PIPELINE, cullPipeline);
+    }
+}
+
+VkShaderModule VKSetUp::cachedShaderModule(const std::string& path)
+{
+    // Kept until cleanup, the variants compiled later need them again
+    for (const auto& [modulePath, module] : shaderModules)
+    {
+        if (modulePath == path)
+            return module;
+    }
+
+    return shaderModules.emplace_back(path, createShaderModule(readFile(path))).second;
+}
+
+VkPipeline VKSetUp::buildClassicPipeline(uint32_t variant)
+{
+    Specialization<FragShader> specialization(variant);
+    VkSpecializationInfo       specializationInfo = specialization.info();
+
+    VkVertexInputBindingDescription vtxBinding{};
+    vtxBinding.binding      = 0;
+    vtxBinding.stride       = sizeof(MeshVertex);
+    vtxBinding.inputRate    = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    VkVertexInputAttributeDescription vtxAttributes[2]{};
+    vtxAttributes[0].location   = 0;
+    vtxAttributes[0].format     = VK_FORMAT_R32G32B32A32_SFLOAT;
+    vtxAttributes[0].offset     = offsetof(MeshVertex, position);
+    vtxAttributes[1].location   = 1;
+    vtxAttributes[1].format     = VK_FORMAT_R32G32B32A32_SFLOAT;
+    vtxAttributes[1].offset     = offsetof(MeshVertex, normal);
+
+    VkPipelineVertexInputStateCreateInfo vtxInputInfo{};
+    vtxInputInfo.sType                              = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vtxInputInfo.vertexBindingDescriptionCount      = 1;
+    vtxInputInfo.pVertexBindingDescriptions         = &vtxBinding;
+    vtxInputInfo.vertexAttributeDescriptionCount    = 2;
+    vtxInputInfo.pVertexAttributeDescriptions       = vtxAttributes;
+
+    VkPipelineShaderStageCreateInfo classicStages[] = {
+        shaderStageInfo(VK_SHADER_STAGE_VERTEX_BIT, cachedShaderModule(SHADER_DIR "mesh_vert.spv")),
+        shaderStageInfo(VK_SHADER_STAGE_FRAGMENT_BIT, cachedShaderModule(SHADER_DIR "frag.spv"), &specializationInfo) };
+    return buildGraphicsPipeline(classicStages, 2, &vtxInputInfo, VK_FRONT_FACE_COUNTER_CLOCKWISE, meshLayout, true);
+}
+
+VkPipeline VKSetUp::buildMeshletPipeline(uint32_t variant)
+{
+    Specialization<FragShader> specialization(variant);
+    VkSpecializationInfo       specializationInfo = specialization.info();
+    VkShaderModule             frag = cachedShaderModule(SHADER_DIR "frag.spv");
+
+    if (meshletPath == RenderPath::MeshletTask)
+    {
+        VkPipelineShaderStageCreateInfo stages[] = {
+            shaderStageInfo(VK_SHADER_STAGE_TASK_BIT_EXT, cachedShaderModule(SHADER_DIR "meshlet_task.spv")),
+            shaderStageInfo(VK_SHADER_STAGE_MESH_BIT_EXT, cachedShaderModule(SHADER_DIR "meshlet_mesh.spv")),
+            shaderStageInfo(VK_SHADER_STAGE_FRAGMENT_BIT, frag, &specializationInfo) };
+        return buildGraphicsPipeline(stages, 3, nullptr, VK_FRONT_FACE_COUNTER_CLOCKWISE, meshLayout, true);
+    }
+
+    // Vertices are pulled from the storage buffers
+    VkPipelineVertexInputStateCreateInfo emptyInput{};
+    emptyInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+    VkPipelineShaderStageCreateInfo stages[] = {
+        shaderStageInfo(VK_SHADER_STAGE_VERTEX_BIT, cachedShaderModule(SHADER_DIR "meshlet_vert.spv")),
+        shaderStageInfo(VK_SHADER_STAGE_FRAGMENT_BIT, frag, &specializationInfo) };
+    return buildGraphicsPipeline(stages, 2, &emptyInput, VK_FRONT_FACE_COUNTER_CLOCKWISE, meshLayout, true);
+}
+
+VkPipeline* VKSetUp::pipelineVariantSlot(CapturePipeline pipeline, uint32_t features)
+{
+    switch (pipeline)
+    {
+    case CapturePipeline::Triangle:
+        return layout ? &trianglePipelines[TriangleVariants::select(features)] : nullptr;
+    case CapturePipeline::Classic:
+        return meshLayout ? &classicPipelines[SceneVariants::select(features)] : nullptr;
+    case CapturePipeline::Meshlet:
+        return meshLayout && meshletPath != RenderPath::Classic ? &meshletPipelines[SceneVariants::select(features)] : nullptr;
+    default:
+        return nullptr;
+    }
+}
+
+void VKSetUp::compilePipelineVariant(CapturePipeline pipeline, uint32_t features, bool onFirstUse)
+{
+    VkPipeline* slot = pipelineVariantSlot(pipeline, features);
+    if (!slot)
+        throw std::runtime_error("the pipeline doesn't exist on this device or scene");
+    if (*slot)
+        return;
+
+    // On first use, it's a hitch on the frame that needs it instead of a longer startup for every run
+    TRACE_SCOPE("compile pipeline variant", "init");
+    auto start = std::chrono::high_resolution_clock::now();
+
+    CompiledVariant compiled;
+    switch (pipeline)
+    {
+    case CapturePipeline::Triangle:
+        compiled.features   = TriangleVariants::select(features);
+        compiled.pipeline   = "triangle";
+        *slot               = buildTrianglePipeline(compiled.features);
+        break;
+    case CapturePipeline::Classic:
+        compiled.features   = SceneVariants::select(features);
+        compiled.pipeline   = "classic";
+        *slot               = buildClassicPipeline(compiled.features);
+        break;
+    default:
+        compiled.features   = SceneVariants::select(features);
+        compiled.pipeline   = "meshlet";
+        *slot               = buildMeshletPipeline(compiled.features);
+        break;
+    }
+
+    compiled.ms         = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    compiled.onFirstUse = onFirstUse;
+    compiledVariants.push_back(compiled);
+
+    if (onFirstUse)
+    {
+        std::cout << "compiled the " << compiled.pipeline << " pipeline [" << variantName<FragShader>(compiled.features)
+            << "] on first use in " << compiled.ms << " ms" << std::endl;
+    }
+}
+
+void VKSetUp::compileAllVariants()
+{
+    for (uint32_t features = 0; features < (1u << FragShader::features.size()); features++)
+    {
+        for (CapturePipeline pipeline : { CapturePipeline::Triangle, CapturePipeline::Classic, CapturePipeline::Meshlet })
+        {
+            if (pipelineVariantSlot(pipeline, features))
+                compilePipelineVariant(pipeline, features, false);
+        }
+    }
+}
+
+void VKSetUp::printShaderVariantReport(std::ostream& out) const
+{
+    // Permutations allowed by the descriptors, for the pipelines this device and scene have
+    uint32_t allowed = layout ? TriangleVariants::count : 0;
+    if (meshLayout)
+        allowed += SceneVariants::count * (meshletPath != RenderPath::Classic ? 2 : 1);
+
+    double totalMs = 0.0;
+    for (const auto& compiled : compiledVariants)
+        totalMs += compiled.ms;
+
+    out << "shader variants: shader.frag has " << FragShader::features.size() << " features, "
+        << allowed << " pipeline variants allowed, " << compiledVariants.size() << " compiled in " << totalMs << " ms" << std::endl;
+
+    for (const auto& compiled : compiledVariants)
+    {
+        out << "  " << compiled.pipeline << " [" << variantName<FragShader>(compiled.features) << "]: "
+            << compiled.ms << " ms" << (compiled.onFirstUse ? " (on first use)" : "") << std::endl;
+    }
+}
+
+void VKSetUp::createMeshletScene()
+{
+    if (!meshletScene)
+        return;
+
+    prepareMeshletScene();
+    createMeshletPipelines();
+
+    indexCount   = static_cast<uint32_t>(sceneIndices.size());
+    meshletCount = static_cast<uint32_t>(sceneMesh.meshlets.size());
+
+    vertexBuffer     = createDeviceLocalBuffer(sceneVertices.data(), sizeof(MeshVertex) * sceneVertices.size(),
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    indexBuffer      = createDeviceLocalBuffer(sceneIndices.data(), sizeof(uint32_t) * sceneIndices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+    meshletBuffer    = createDeviceLocalBuffer(sceneMesh.meshlets.data(), sizeof(Meshlet) * sceneMesh.meshlets.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    boundsBuffer     = createDeviceLocalBuffer(sceneMesh.bounds.data(), sizeof(MeshletBounds) * sceneMesh.bounds.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    meshletVtxBuffer = createDeviceLocalBuffer(sceneMesh.meshletVertices.data(), sizeof(uint32_t) * sceneMesh.meshletVertices.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    meshletTriBuffer = createDeviceLocalBuffer(sceneMesh.meshletTriangles.data(), sizeof(uint32_t) * sceneMesh.meshletTriangles.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    indirectBuffer   = createBuffer(sizeof(VkDrawIndirectCommand) * meshletCount,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    // The GPU has its copy, release the CPU one
+    sceneVertices   = {};
+    sceneIndices    = {};
+    sceneMesh       = {};
+
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type               = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount    = MESHLET_BINDING_COUNT;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType          = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets        = 1;
+    poolInfo.poolSizeCount  = 1;
+    poolInfo.pPoolSizes     = &poolSize;
+
+    if (vkCreateDescriptorPool(device, &poolInfo, ResourceTracker::allocator(), &meshletPool) != VK_SUCCESS)
+        throw std::runtime_error("failed to create the meshlet descriptor pool");
+    ResourceTracker::created(VK_OBJECT_TYPE_DESCRIPTOR_POOL, meshletPool);
+
+    VkDescriptorSetAllocateInfo setAllocInfo{};
+    setAllocInfo.sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    setAllocInfo.descriptorPool     = meshletPool;
+    setAllocInfo.descriptorSetCount = 1;
+    setAllocInfo.pSetLayouts        = &meshletSetLayout;
+
+    if (vkAllocateDescriptorSets(device, &setAllocInfo, &meshletSet) != VK_SUCCESS)
+        throw std::runtime_error("failed to allocate the meshlet descriptor set");
+
+    const GpuBuffer* buffers[MESHLET_BINDING_COUNT] = { &vertexBuffer, &meshletBuffer, &boundsBuffer, &meshletVtxBuffer, &meshletTriBuffer, &indirectBuffer };
+    VkDescriptorBufferInfo bufferInfos[MESHLET_BINDING_COUNT]{};
+    VkWriteDescriptorSet   writes[MESHLET_BINDING_COUNT]{};
+    for (uint32_t i = 0; i < MESHLET_BINDING_COUNT; i++)
+    {
+        bufferInfos[i].buffer   = buffers[i]->buffer;
+        bufferInfos[i].offset   = 0;
+        bufferInfos[i].range    = VK_WHOLE_SIZE;
+
+        writes[i].sType             = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet            = meshletSet;
+        writes[i].dstBinding        = i;
+        writes[i].descriptorCount   = 1;
+        writes[i].descriptorType    = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[i].pBufferInfo       = &bufferInfos[i];
+    }
+    vkUpdateDescriptorSets(device, MESHLET_BINDING_COUNT, writes, 0, nullptr);
+}
+
+MeshPushConstants VKSetUp::sceneConstants(VkExtent2D extent) const
+{
+    // Orbit close to the sphere so part of it is always out of the frustum
+    glm::vec3 eye(std::sin(sceneTime * 0.5f) * 1.8f, 0.6f, std::cos(sceneTime * 0.5f) * 1.8f);
+    glm::mat4 view = glm::lookAt(eye, glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f));
+    glm::mat4 proj = glm::perspective(glm::radians(60.f), static_cast<float>(extent.width) / static_cast<float>(extent.height), 0.1f, 100.f);
+    proj[1][1] *= -1.f; // Vulkan's Y axis points down
+
+    MeshPushConstants pc{};
+    pc.viewProj     = proj * view;
+    pc.cameraPos    = glm::vec4(eye, 1.f);
+    pc.meshletCount = meshletCount;
+
+    return pc;
+}
+
+void VKSetUp::recordMeshletCulling(VkCommandBuffer cmd, VkExtent2D extent)
+{
+    // Every view culls into the same indirect buffer, so wait for the draws of the previous one
+    cmdMemoryBarrier(cmd, {
+        VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT });
+
+    cmdBindPipeline(cmd, { CapturePipeline::Cull });
+    cmdBindMeshletSet(cmd, { CapturePipeline::Cull });
+    cmdPushConstants(cmd, sceneConstants(extent));
+    cmdDraw(cmd, FrameOp::Dispatch, { (meshletCount + 63) / 64 });
+
+    // The draw commands written by the compute shader are consumed by vkCmdDrawIndirect
+    cmdMemoryBarrier(cmd, {
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT });
+}
+
+void VKSetUp::recordMeshletScene(VkCommandBuffer cmd, VkExtent2D extent)
+{
+    MeshPushConstants pc = sceneConstants(extent);
+    uint8_t features = static_cast<uint8_t>(shaderFeatures);
+
+    switch (renderPath)
+    {
+    case RenderPath::Classic:
+        cmdBindPipeline(cmd, { CapturePipeline::Classic, features });
+        cmdPushConstants(cmd, pc);
+        cmdBindMeshBuffers(cmd);
+        cmdDraw(cmd, FrameOp::DrawIndexed, { indexCount });
+        break;
+    case RenderPath::MeshletTask:
+        // One task workgroup culls 32 meshlets
+        cmdBindPipeline(cmd, { CapturePipeline::Meshlet, features });
+        cmdBindMeshletSet(cmd, { CapturePipeline::Meshlet });
+        cmdPushConstants(cmd, pc);
+        cmdDraw(cmd, FrameOp::DrawMeshTasks, { (meshletCount + 31) / 32 });
+        break;
+    case RenderPath::MeshletCompute:
+        // Culled meshlets were turned into empty draws by recordMeshletCulling
+        cmdBindPipeline(cmd, { CapturePipeline::Meshlet, features });
+        cmdBindMeshletSet(cmd, { CapturePipeline::Meshlet });
+        cmdPushConstants(cmd, pc);
+        cmdDraw(cmd, FrameOp::DrawIndirect, { meshletCount });
+        break;
+    }
+}
+#pragma endregion
+
 void VKSetUp::drawFrame()
 {
+    TRACE_SCOPE("drawFrame", "cpu", frameIndex);
+
     // Wait for fences
+    {
+        TRACE_SCOPE("wait frame fence");
+        if (vkWaitForFences(device, 1, &drawFence, VK_TRUE, UINT64_MAX) != VK_SUCCESS)
+            throw std::runtime_error("Could not wait for the fence? (idk)");
+        vkResetFences(device, 1, &drawFence);
+    }
+
+    // GPU ranges of the previous frame
+    for (auto& view : views)
+        readGpuTrace(view);
+    traceGpu = tracePool && Trace::isEnabled();
+
+    // The previous frame is done, feed its GPU time to the resolution controller
+    if (drs.enabled)
+    {
+        for (auto& view : views)
+            readTimestamps(view);
+    }
+
+    auto frameStart = std::chrono::high_resolution_clock::now();
+    if (recorder.isRecording())
+        recorder.beginFrame(frameIndex);
+
+    // The scene advances at a fixed step so runs are comparable
+    sceneTime = static_cast<float>(frameIndex++) / 60.f;
+
+    // The transient structs of the frame live in the arena, nothing here touches the heap
+    frameArena.reset();
+
+    // The swap chain image is first written and last written at the same stage: the color
+    // output, or the upscale blit with dynamic resolution. Waits and signals use exactly it
+    VkPipelineStageFlags2 stage = outputStage();
+
+    size_t viewCount = views.size();
+    VkSemaphoreSubmitInfo* waitInfos   = frameArena.allocate<VkSemaphoreSubmitInfo>(viewCount);
+    VkSemaphoreSubmitInfo* signalInfos = frameArena.allocate<VkSemaphoreSubmitInfo>(viewCount);
+
+    for (size_t i = 0; i < viewCount; i++)
+    {
+        RenderView& view = views[i];
+
+        uint32_t waitCount = 0;
+        if (view.swapChain)
+        {
+            // Acquire the next image from the swap chain
+            TRACE_SCOPE("vkAcquireNextImageKHR", "cpu", view.index);
+            VkResult result = vkAcquireNextImageKHR(device, view.swapChain, UINT64_MAX, view.imageAvailable, VK_NULL_HANDLE, &view.imageIndex);
+            if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+                throw std::runtime_error("Could not aquire the next image idx");
+
+            waitInfos[i].sType      = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+            waitInfos[i].semaphore  = view.imageAvailable;
+            waitInfos[i].stageMask  = stage;
+
+            signalInfos[i].sType        = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+            signalInfos[i].semaphore    = view.renderFinished[view.imageIndex];
+            signalInfos[i].stageMask    = stage;
+
+            waitCount = 1;
+        }
+
+        // Record the command buffer
+        {
+            TRACE_SCOPE("recordCommandBuffer", "cpu", view.index);
+            recordCommandBuffer(view);
+        }
+        view.timestampsWritten  = drs.enabled;
+        view.timestampFrame     = frameIndex - 1;
+
+        // Headless views have no waits, the scheduler merges them into a single batch
+        scheduler.submit(graphicsQueue, SubmitProducer::Render, &view.commandBuffer, 1,
+            &waitInfos[i], waitCount, &signalInfos[i], waitCount);
+
+        if (view.swapChain)
+            scheduler.present(presentQueue, view.swapChain, view.imageIndex, view.renderFinished[view.imageIndex]);
+    }
+
+    // Whatever the other producers queued this frame goes out with the views,
+    // in one vkQueueSubmit2 per queue and one present for all the swap chains
+    for (auto& view : views)
+        view.traceSubmitNs = Trace::now();
+
+    scheduler.setFence(graphicsQueue, drawFence);
+    scheduler.flush();
+
+    if (recorder.isRecording())
+    {
+        auto frameEnd = std::chrono::high_resolution_clock::now();
+        recorder.endFrame(std::chrono::duration<float, std::milli>(frameEnd - frameStart).count());
+    }
+}
+
+#pragma region CAPTURE/REPLAY
+void VKSetUp::startCapture(const std::string& path)
+{
+    if (recorder.isRecording())
+        throw std::runtime_error("a capture is already running");
+
+    CaptureHeader header;
+    header.viewCount            = static_cast<uint32_t>(views.size());
+    header.uploadCount          = static_cast<uint32_t>(uploads.size());
+    header.meshletScene         = meshletScene;
+    header.renderPath           = static_cast<uint8_t>(renderPath);
+    header.meshletPath          = static_cast<uint8_t>(meshletPath);
+    header.dynamicResolution    = drs.enabled;
+    header.msaaSamples          = static_cast<uint8_t>(msaaSamples);
+
+    std::vector<CaptureView> captureViews;
+    for (const auto& view : views)
+        captureViews.push_back({ view.extent.width, view.extent.height, static_cast<uint8_t>(view.window ? 1 : 0) });
+
+    recorder.open(path, header, captureViews, uploads);
+}
+
+void VKSetUp::stopCapture()
+{
+    recorder.close();
+}
+
+void VKSetUp::checkCaptureCompatible(const FrameCapture& capture) const
+{
+    if (capture.views.size() != views.size())
+        throw std::runtime_error("the capture has " + std::to_string(capture.views.size()) + " views");
+
+    for (size_t i = 0; i < views.size(); i++)
+    {
+        if (capture.views[i].width != views[i].extent.width || capture.views[i].height != views[i].extent.height)
+            throw std::runtime_error("view " + std::to_string(i) + " doesn't have the extent of the capture");
+    }
+
+    if (capture.header.meshletScene && static_cast<RenderPath>(capture.header.meshletPath) != meshletPath)
+        throw std::runtime_error("the capture was made on another meshlet path, the device doesn't support it or has a better one");
+
+    if (capture.header.dynamicResolution && !drs.enabled)
+        throw std::runtime_error("the capture uses dynamic resolution, which the device can't do");
+
+    if (capture.header.msaaSamples != msaaSamples)
+        throw std::runtime_error("the capture was made with " + std::to_string(capture.header.msaaSamples) + " samples per pixel, the device can't do them");
+
+    // The scene is rebuilt, not loaded, it has to be the same one
+    bool sameUploads = capture.uploads.size() == uploads.size();
+    for (size_t i = 0; sameUploads && i < uploads.size(); i++)
+        sameUploads = capture.uploads[i].size == uploads[i].size && capture.uploads[i].hash == uploads[i].hash;
+    if (!sameUploads)
+        std::cout << "warning: the scene doesn't match the one of the capture, the replay won't be the same workload" << std::endl;
+}
+
+void VKSetUp::replayFrame(const CapturedFrame& frame)
+{
     if (vkWaitForFences(device, 1, &drawFence, VK_TRUE, UINT64_MAX) != VK_SUCCESS)
         throw std::runtime_error("Could not wait for the fence? (idk)");
+    vkResetFences(device, 1, &drawFence);
 
-    // Acquire the next image from the swap chain
-    uint32_t idx = 0;
-    if (vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, presentComplete, drawFence, &idx) != VK_SUCCESS)
-        throw std::runtime_error("Could not aquire the next image idx");
+    FrameOpReader reader(frame.commands);
+    VkCommandBuffer cmd = nullptr;
+    while (!reader.atEnd())
+    {
+        FrameOp op = reader.nextOp();
+        switch (op)
+        {
+        case FrameOp::BeginView:
+        {
+            RenderView& view = views.at(reader.read<CmdBeginView>().view);
+            cmd = view.commandBuffer;
 
-    // Record and send the command buffer
-    recordCommandBuffer(idx);
-    vkResetFences(device, 1, &drawFence);
+            VkCommandBufferBeginInfo beginInfo{};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            vkBeginCommandBuffer(cmd, &beginInfo);
+            break;
+        }
+        case FrameOp::EndView:
+            vkEndCommandBuffer(cmd);
+            scheduler.submit(graphicsQueue, SubmitProducer::Render, &cmd, 1);
+            cmd = nullptr;
+            break;
+        case FrameOp::ImageBarrier:     cmdImageBarrier(cmd, reader.read<CmdImageBarrier>()); break;
+        case FrameOp::MemoryBarrier:    cmdMemoryBarrier(cmd, reader.read<CmdMemoryBarrier>()); break;
+        case FrameOp::BeginRendering:   cmdBeginRendering(cmd, reader.read<CmdBeginRendering>()); break;
+        case FrameOp::EndRendering:     cmdEndRendering(cmd); break;
+        case FrameOp::BindPipeline:     cmdBindPipeline(cmd, reader.read<CmdBindPipeline>()); break;
+        case FrameOp::BindMeshletSet:   cmdBindMeshletSet(cmd, reader.read<CmdBindPipeline>()); break;
+        case FrameOp::BindMeshBuffers:  cmdBindMeshBuffers(cmd); break;
+        case FrameOp::PushConstants:    cmdPushConstants(cmd, reader.read<MeshPushConstants>()); break;
+        case FrameOp::Draw:
+        case FrameOp::DrawIndexed:
+        case FrameOp::DrawIndirect:
+        case FrameOp::DrawMeshTasks:
+        case FrameOp::Dispatch:         cmdDraw(cmd, op, reader.read<CmdDraw>()); break;
+        case FrameOp::ResetTimestamps:
+        case FrameOp::WriteTimestamp:   cmdTimestamp(cmd, op, reader.read<CmdTimestamp>()); break;
+        case FrameOp::Blit:             cmdBlit(cmd, reader.read<CmdBlit>()); break;
+        case FrameOp::CopyToReadback:   cmdCopyToReadback(cmd, reader.read<CmdBeginView>()); break;
+        default:
+            throw std::runtime_error("unknown command in the frame capture");
+        }
+    }
 
-    // Submit the graphics queue
-    VkPipelineStageFlags waitMask   = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.waitSemaphoreCount   = 1;
-    submitInfo.commandBufferCount   = 1;
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores      = &presentComplete;
-    submitInfo.pWaitDstStageMask    = &waitMask;
-    submitInfo.pCommandBuffers      = &commandBuffer;
-    submitInfo.pSignalSemaphores    = &renderFinished;
+    scheduler.setFence(graphicsQueue, drawFence);
+    scheduler.flush();
+}
+#pragma endregion
 
-    vkQueueSubmit(graphicsQueue, 1, &submitInfo, drawFence);
+VkPipelineStageFlags2 VKSetUp::outputStage() const
+{
+    return drs.enabled ? VK_PIPELINE_STAGE_2_BLIT_BIT : VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+}
 
-    // Present
-    VkPresentInfoKHR present{};
-    present.sType               = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-    present.waitSemaphoreCount  = 1;
-    present.swapchainCount      = 1;
-    present.pWaitSemaphores     = &renderFinished;
-    present.pSwapchains         = &swapChain;
-    present.pImageIndices       = &idx;
+void VKSetUp::readTimestamps(RenderView& view)
+{
+    if (!view.timestampsWritten)
+        return;
+    view.timestampsWritten = false;
+
+    uint64_t stamps[2]{};
+    VkResult result = vkGetQueryPoolResults(device, timestampPool, view.index * 2, 2, sizeof(stamps), stamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS)
+        return;
 
-    if (vkQueuePresentKHR(graphicsQueue, &present) != VK_SUCCESS)
-        throw std::runtime_error("Could not present the image");
+    // Ticks to milliseconds
+    float gpuMs = static_cast<float>(static_cast<double>(stamps[1] - stamps[0]) * capabilities.timestampPeriod / 1e6);
+
+    ResolutionSample& sample = telemetry[telemetryCount++ % telemetry.size()];
+    sample.frame    = view.timestampFrame;
+    sample.view     = view.index;
+    sample.gpuMs    = gpuMs;
+    sample.scale    = view.resolutionScale;
+    sample.extent   = view.renderExtent;
+
+    updateResolutionScale(view, gpuMs);
+}
+
+void VKSetUp::traceGpuPass(VkCommandBuffer cmd, RenderView& view, GpuPass pass, bool end)
+{
+    if (!traceGpu)
+        return;
+
+    // Not a frame command: the trace ranges aren't part of the workload, captures leave them out
+    uint32_t query = (view.index * static_cast<uint32_t>(GpuPass::Count) + static_cast<uint32_t>(pass)) * 2 + (end ? 1 : 0);
+    vkCmdWriteTimestamp2(cmd, end ? VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT : VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, tracePool, query);
+
+    if (end)
+        view.tracedPasses |= 1u << static_cast<uint32_t>(pass);
+}
+
+void VKSetUp::readGpuTrace(RenderView& view)
+{
+    static const char* passNames[] = { "cull", "scene", "upscale", "output" };
+    static_assert(std::size(passNames) == static_cast<size_t>(GpuPass::Count));
+
+    if (!view.tracedPasses)
+        return;
+
+    const uint32_t passCount = static_cast<uint32_t>(GpuPass::Count);
+    uint64_t stamps[passCount * 2]{};
+    uint64_t firstNs = UINT64_MAX;
+    for (uint32_t pass = 0; pass < passCount; pass++)
+    {
+        if (!(view.tracedPasses & (1u << pass)))
+            continue;
+
+        uint32_t query = (view.index * passCount + pass) * 2;
+        if (vkGetQueryPoolResults(device, tracePool, query, 2, sizeof(uint64_t) * 2, &stamps[pass * 2], sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+            view.tracedPasses &= ~(1u << pass);
+        else
+            firstNs = std::min(firstNs, static_cast<uint64_t>(static_cast<double>(stamps[pass * 2]) * capabilities.timestampPeriod));
+    }
+
+    if (!view.tracedPasses)
+        return;
+
+    // Without calibrated timestamps, the GPU clock is placed so no frame starts before it was
+    // submitted. The offset only grows, it converges to the real one after a few idle GPU frames
+    int64_t offset = static_cast<int64_t>(view.traceSubmitNs) - static_cast<int64_t>(firstNs);
+    if (!gpuTraceSynced || offset > gpuTraceOffset)
+        gpuTraceOffset = offset;
+    gpuTraceSynced = true;
+
+    for (uint32_t pass = 0; pass < passCount; pass++)
+    {
+        if (!(view.tracedPasses & (1u << pass)))
+            continue;
+
+        double beginNs = static_cast<double>(stamps[pass * 2]) * capabilities.timestampPeriod;
+        double endNs   = static_cast<double>(stamps[pass * 2 + 1]) * capabilities.timestampPeriod;
+        Trace::complete(passNames[pass], "gpu", static_cast<uint64_t>(static_cast<int64_t>(beginNs) + gpuTraceOffset),
+            static_cast<uint64_t>(std::max(0.0, endNs - beginNs)), view.gpuTrack, view.index);
+    }
+    view.tracedPasses = 0;
+}
+
+void VKSetUp::updateResolutionScale(RenderView& view, float gpuMs)
+{
+    // Smooth the measure so a single spike doesn't make the resolution jump
+    view.smoothedGpuMs = view.smoothedGpuMs > 0.f ? view.smoothedGpuMs * 0.9f + gpuMs * 0.1f : gpuMs;
+
+    // Dead band around the target, otherwise the scale never settles
+    float ratio = drs.targetMs / std::max(view.smoothedGpuMs, 0.001f);
+    if (ratio > 0.95f && ratio < 1.05f)
+        return;
+
+    // The cost follows the pixel count, so the per axis scale goes with the square root.
+    // Small steps keep the changes invisible and the controller stable
+    float wanted = view.resolutionScale * std::sqrt(ratio);
+    float step   = std::clamp(wanted - view.resolutionScale, -0.02f, 0.02f);
+    view.resolutionScale = std::clamp(view.resolutionScale + step, drs.minScale, drs.maxScale);
+}
+
+std::vector<ResolutionSample> VKSetUp::getResolutionTelemetry() const
+{
+    // Oldest first
+    std::vector<ResolutionSample> samples;
+    size_t count = std::min(telemetryCount, telemetry.size());
+    samples.reserve(count);
+    for (size_t i = telemetryCount - count; i < telemetryCount; i++)
+        samples.push_back(telemetry[i % telemetry.size()]);
+
+    return samples;
+}
+
+void VKSetUp::copyViewPixels(size_t viewIdx, std::vector<uint8_t>& pixels) const
+{
+    const RenderView& view = views.at(viewIdx);
+    if (!view.readbackData)
+        throw std::runtime_error("the view has no readback, call enableReadback before createSwapChain");
+
+    // The copy was recorded in the frame, so it's done with the fence
+    if (vkWaitForFences(device, 1, &drawFence, VK_TRUE, UINT64_MAX) != VK_SUCCESS)
+        throw std::runtime_error("Could not wait for the fence? (idk)");
+
+    const uint8_t* data = static_cast<const uint8_t*>(view.readbackData);
+    pixels.assign(data, data + view.readback.size);
 }
 
 void VKSetUp::cleanup()
 {
-    for (auto image : SCImageView)
-        vkDestroyImageView(device, image, nullptr);
-
-    vkDestroySwapchainKHR(device, swapChain, nullptr);
-    vkDestroyShaderModule(device, vShadMod, nullptr);
-    vkDestroyShaderModule(device, fShadMod, nullptr);
-    vkDestroyPipelineLayout(device, layout, nullptr);
-    vkDestroyPipeline(device, graphicsPipeline, nullptr);
-    vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
-    vkDestroyCommandPool(device, commandPool, nullptr);
-    vkDestroyDevice(device, nullptr);
-    vkDestroySurfaceKHR(instance, surface, nullptr);
-    vkDestroyInstance(instance, nullptr);
-    glfwDestroyWindow(window);
-    glfwTerminate();
+    recorder.close();
+
+    // Also called on a setUp whose init threw halfway, everything not created yet is null
+    if (device)
+    {
+        vkDeviceWaitIdle(device);
+
+        for (auto& view : views)
+        {
+            if (view.swapChain)
+            {
+                for (auto image : view.imageViews)
+                {
+                    ResourceTracker::destroyed(VK_OBJECT_TYPE_IMAGE_VIEW, image);
+                    vkDestroyImageView(device, image, ResourceTracker::allocator());
+                }
+                for (auto semaphore : view.renderFinished)
+                {
+                    ResourceTracker::destroyed(VK_OBJECT_TYPE_SEMAPHORE, semaphore);
+                    vkDestroySemaphore(device, semaphore, ResourceTracker::allocator());
+                }
+
+                ResourceTracker::destroyed(VK_OBJECT_TYPE_SEMAPHORE, view.imageAvailable);
+                vkDestroySemaphore(device, view.imageAvailable, ResourceTracker::allocator());
+                ResourceTracker::destroyed(VK_OBJECT_TYPE_SWAPCHAIN_KHR, view.swapChain);
+                vkDestroySwapchainKHR(device, view.swapChain, ResourceTracker::allocator());
+            }
+            else
+            {
+                destroyImage(view.offscreen);
+                destroyBuffer(view.readback);
+            }
+
+            if (commandPool)
+                vkFreeCommandBuffers(device, commandPool, 1, &view.commandBuffer);
+        }
+        renderTargets.destroy();
+        ResourceTracker::destroyed(VK_OBJECT_TYPE_FENCE, drawFence);
+        vkDestroyFence(device, drawFence, ResourceTracker::allocator());
+        ResourceTracker::destroyed(VK_OBJECT_TYPE_QUERY_POOL, timestampPool);
+        vkDestroyQueryPool(device, timestampPool, ResourceTracker::allocator());
+        ResourceTracker::destroyed(VK_OBJECT_TYPE_QUERY_POOL, tracePool);
+        vkDestroyQueryPool(device, tracePool, ResourceTracker::allocator());
+
+        ResourceTracker::destroyed(VK_OBJECT_TYPE_SHADER_MODULE, vShadMod);
+        vkDestroyShaderModule(device, vShadMod, ResourceTracker::allocator());
+        ResourceTracker::destroyed(VK_OBJECT_TYPE_SHADER_MODULE, fShadMod);
+        vkDestroyShaderModule(device, fShadMod, ResourceTracker::allocator());
+        ResourceTracker::destroyed(VK_OBJECT_TYPE_PIPELINE_LAYOUT, layout);
+        vkDestroyPipelineLayout(device, layout, ResourceTracker::allocator());
+        for (VkPipeline pipeline : trianglePipelines)
+        {
+            ResourceTracker::destroyed(VK_OBJECT_TYPE_PIPELINE, pipeline);
+            vkDestroyPipeline(device, pipeline, ResourceTracker::allocator());
+        }
+        ResourceTracker::destroyed(VK_OBJECT_TYPE_COMMAND_POOL, commandPool);
+        vkDestroyCommandPool(device, commandPool, ResourceTracker::allocator());
+
+        // Meshlet scene (all null if it wasn't enabled)
+        for (GpuBuffer* buffer : { &vertexBuffer, &indexBuffer, &meshletBuffer, &boundsBuffer, &meshletVtxBuffer, &meshletTriBuffer, &indirectBuffer })
+            destroyBuffer(*buffer);
+        for (size_t i = 0; i < classicPipelines.size(); i++)
+        {
+            ResourceTracker::destroyed(VK_OBJECT_TYPE_PIPELINE, classicPipelines[i]);
+            vkDestroyPipeline(device, classicPipelines[i], ResourceTracker::allocator());
+            ResourceTracker::destroyed(VK_OBJECT_TYPE_PIPELINE, meshletPipelines[i]);
+            vkDestroyPipeline(device, meshletPipelines[i], ResourceTracker::allocator());
+        }
+        ResourceTracker::destroyed(VK_OBJECT_TYPE_PIPELINE, cullPipeline);
+        vkDestroyPipeline(device, cullPipeline, ResourceTracker::allocator());
+        for (const auto& [path, module] : shaderModules)
+        {
+            ResourceTracker::destroyed(VK_OBJECT_TYPE_SHADER_MODULE, module);
+            vkDestroyShaderModule(device, module, ResourceTracker::allocator());
+        }
+        ResourceTracker::destroyed(VK_OBJECT_TYPE_PIPELINE_LAYOUT, meshLayout);
+        vkDestroyPipelineLayout(device, meshLayout, ResourceTracker::allocator());
+        ResourceTracker::destroyed(VK_OBJECT_TYPE_DESCRIPTOR_POOL, meshletPool);
+        vkDestroyDescriptorPool(device, meshletPool, ResourceTracker::allocator());
+        ResourceTracker::destroyed(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT, meshletSetLayout);
+        vkDestroyDescriptorSetLayout(device, meshletSetLayout, ResourceTracker::allocator());
+
+        ResourceTracker::destroyed(VK_OBJECT_TYPE_DEVICE, device);
+        vkDestroyDevice(device, ResourceTracker::allocator());
+    }
+    if (instance)
+    {
+        for (auto& view : views)
+        {
+            ResourceTracker::destroyed(VK_OBJECT_TYPE_SURFACE_KHR, view.surface);
+            vkDestroySurfaceKHR(instance, view.surface, ResourceTracker::allocator());
+        }
+        ResourceTracker::destroyed(VK_OBJECT_TYPE_INSTANCE, instance);
+        vkDestroyInstance(instance, ResourceTracker::allocator());
+    }
+    debugSink->stop();
+
+    for (auto& view : views)
+        glfwDestroyWindow(view.window);
+    if (glfwInitialized)
+        glfwTerminate();
 }
\ No newline at end of file
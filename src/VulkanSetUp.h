@@ -1,3 +1,5 @@
+#pragma once
+
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
@@ -10,6 +12,15 @@
 #include <string>
 #include <limits>
 #include <algorithm>
+#include <memory>
+
+#include "Meshlet.h"
+#include "FrameArena.h"
+#include "SubmitScheduler.h"
+#include "FrameCapture.h"
+#include "DebugSink.h"
+#include "RenderTargetPool.h"
+#include "ShaderVariants.h"
 
 struct QueueFamilyIndices
 {
@@ -25,6 +36,131 @@ struct SwapChainSupportDetails
     std::vector<VkPresentModeKHR> presentModes;
 };
 
+// What a GPU can do, filled in pickPhysicalDevice. The rest of the renderer checks
+// the one of the picked device to turn on its fast paths
+struct DeviceCapabilities
+{
+    std::string             name;
+    std::string             uuid;                   // deviceUUID as 32 lowercase hex characters
+    unsigned                index       = 0;        // Position in vkEnumeratePhysicalDevices
+    VkPhysicalDeviceType    type        = VK_PHYSICAL_DEVICE_TYPE_OTHER;
+    uint32_t                apiVersion  = 0;
+    VkDeviceSize            deviceLocalMemory = 0;  // Sum of the DEVICE_LOCAL heaps
+
+    bool dedicatedCompute   = false;    // A queue family with compute but no graphics
+    bool dedicatedTransfer  = false;    // A queue family with transfer only
+
+    bool meshShader                 = false;    // Task and mesh shaders (VK_EXT_mesh_shader)
+    bool multiDrawIndirect          = false;
+    bool drawIndirectFirstInstance  = false;
+
+    bool                timestamps      = false;    // Timestamps on every graphics and compute queue
+    float               timestampPeriod = 0.f;      // Nanoseconds per timestamp tick
+    VkSampleCountFlags  sampleCounts    = VK_SAMPLE_COUNT_1_BIT;    // Supported by color and depth attachments
+
+    int score = 0;
+};
+
+// Which geometry path draws the meshlet scene
+enum class RenderPath
+{
+    Classic,        // Vertex/index buffers, no culling
+    MeshletTask,    // Task shader culls meshlets, mesh shader emits them (VK_EXT_mesh_shader)
+    MeshletCompute  // Compute shader culls meshlets into indirect draws, vertex pulling
+};
+
+struct GpuBuffer
+{
+    VkBuffer        buffer = nullptr;
+    VkDeviceMemory  memory = nullptr;
+    VkDeviceSize    size   = 0;
+};
+
+struct GpuImage
+{
+    VkImage         image  = nullptr;
+    VkDeviceMemory  memory = nullptr;
+    VkImageView     view   = nullptr;
+};
+
+// Dynamic resolution: the views render into an internal target whose size follows the GPU
+// frame time (timestamp queries), then it's blitted to the swap chain/offscreen image
+struct DynamicResolutionSettings
+{
+    bool    enabled     = false;
+    float   targetMs    = 8.f;      // GPU time to aim for, per view
+    float   minScale    = 0.5f;     // Bounds of the per axis scale of the internal target
+    float   maxScale    = 1.f;
+};
+
+// Telemetry of the dynamic resolution, one sample per view and frame
+struct ResolutionSample
+{
+    uint64_t    frame   = 0;
+    uint32_t    view    = 0;
+    float       gpuMs   = 0.f;      // Measured on the frame
+    float       scale   = 1.f;      // Scale the frame was rendered at
+    VkExtent2D  extent{};
+};
+
+// GPU ranges of a frame shown in the trace, timestamps around each of them
+enum class GpuPass : uint32_t
+{
+    Cull,       // Compute meshlet culling
+    Scene,
+    Upscale,    // Dynamic resolution blit
+    Output,     // Final transition and readback copy
+    Count
+};
+
+// Everything that belongs to one output. The instance, device, queues, pipelines
+// and the scene are shared by all the views
+struct RenderView
+{
+    GLFWwindow*     window      = nullptr;  // Null for headless views
+    VkSurfaceKHR    surface     = nullptr;
+    VkSwapchainKHR  swapChain   = nullptr;
+    VkExtent2D      extent{};
+    SwapChainSupportDetails support;        // Queried once when the device is picked
+
+    std::vector<VkImage>        images;         // Swap chain images, or the offscreen target
+    std::vector<VkImageView>    imageViews;
+    GpuImage                    offscreen;      // Headless only
+    GpuBuffer                   readback;       // Headless only, host copy of the offscreen image
+    void*                       readbackData    = nullptr;
+
+    VkCommandBuffer             commandBuffer   = nullptr;
+    VkSemaphore                 imageAvailable  = nullptr;  // Acquire -> render
+    std::vector<VkSemaphore>    renderFinished;             // Render -> present, one per swap chain image
+    uint32_t                    imageIndex      = 0;
+    uint32_t                    index           = 0;        // Position in VKSetUp::views
+
+    // Per frame targets, in VKSetUp::renderTargets
+    RenderTargetHandle  depth       = NO_RENDER_TARGET;     // Meshlet scene only
+    RenderTargetHandle  internal    = NO_RENDER_TARGET;     // Dynamic resolution, full extent, only a part of it is rendered
+    RenderTargetHandle  msaaColor   = NO_RENDER_TARGET;     // Multisampling, resolved into the target at the end of the scene pass
+
+    // Dynamic resolution
+    float       resolutionScale = 1.f;
+    float       smoothedGpuMs   = 0.f;
+    bool        timestampsWritten = false;
+    uint64_t    timestampFrame  = 0;
+    VkExtent2D  renderExtent{};             // Extent of the last recorded frame
+
+    // Tracing
+    uint32_t    gpuTrack        = 0;        // Trace track of the GPU work of the view
+    uint32_t    tracedPasses    = 0;        // Bit per GpuPass written in the last frame
+    uint64_t    traceSubmitNs   = 0;        // Trace clock when the last frame was submitted
+};
+
+// Push constants shared by all the meshlet scene shaders
+struct MeshPushConstants
+{
+    glm::mat4   viewProj;
+    glm::vec4   cameraPos;
+    uint32_t    meshletCount;
+};
+
 // vector of validation layers you want to use to debug
 const std::vector<const char*> validationLayers = { "VK_LAYER_KHRONOS_validation" };
 
@@ -39,9 +175,15 @@ public:
 
     void InitWindow(unsigned width, unsigned height);
 
+    // Views have to be added before createInstance. Returns the index of the view
+    size_t addWindow(unsigned width, unsigned height);
+    size_t addHeadlessView(unsigned width, unsigned height);
+
     std::vector<const char*>    getRequiredExtensions(const bool& enableLayer);
-    GLFWwindow*                 getWindow() const { return window; }
+    GLFWwindow*                 getWindow() const;
     VkDevice                    getDevice() const { return device; }
+    size_t                      getViewCount() const { return views.size(); }
+    bool                        shouldClose() const;
     
     void setupDebugMessenger(const bool& enableLayer);
     void pickPhysicalDevice();
@@ -54,9 +196,87 @@ public:
     void createCommandPool();
     void createCommandBuffer();
     void createSyncObjs();
+    void createMeshletScene();
+
+    // createSwapChain, createGraphicsPipeline and createMeshletScene call these when they weren't,
+    // they're only split out so startup can run them on other threads:
+    // - selectFormats picks the color/depth formats, the pipelines and the swap chain can then be created concurrently
+    // - prepareMeshletScene generates the geometry on the CPU, it doesn't need the device
+    // - createMeshletPipelines needs the device and the formats, not the geometry
+    // Pipelines the first frames don't use (triangle with the meshlet scene, classic when a meshlet path draws)
+    // are compiled the first time a frame uses them
+    void selectFormats();
+    void prepareMeshletScene();
+    void createMeshletPipelines();
+
+    // The meshlet scene replaces the hello triangle, must be set before pickPhysicalDevice
+    void        enableMeshletScene(bool enable) { meshletScene = enable; }
+    void        setUncappedPresent(bool enable) { uncappedPresent = enable; }
+    void        setRenderPath(RenderPath path);
+
+    // FragShader features of the pipelines the frames bind. Variants no frame used yet are compiled
+    // on their first use, compileAllVariants builds every variant the pipelines allow
+    void        setShaderFeatures(uint32_t features) { shaderFeatures = features; }
+    uint32_t    getShaderFeatures() const { return shaderFeatures; }
+    void        compileAllVariants();
+    void        printShaderVariantReport(std::ostream& out) const;
+    RenderPath  getRenderPath() const   { return renderPath; }
+    RenderPath  getMeshletPath() const  { return meshletPath; }
+
+    // Name (or part of it), UUID or enumeration index of the GPU to use instead of the best scored one.
+    // The VKPROJ_DEVICE environment variable is used when it isn't set
+    void                        setDeviceOverride(const std::string& device_) { deviceOverride = device_; }
+    // Every GPU of the instance with its score and UUID, and the one pickPhysicalDevice would take
+    void                        printDevices(std::ostream& out) const;
+    const DeviceCapabilities&   getCapabilities() const { return capabilities; }
+    const FrameArena&           getFrameArena() const { return frameArena; }
+    const RenderTargetPool&     getRenderTargets() const { return renderTargets; }
+
+    // Producers outside of the renderer (uploads, compute...) queue their work here before drawFrame,
+    // it's flushed along with the views
+    SubmitScheduler&            getSubmitScheduler() { return scheduler; }
 
     void drawFrame();
 
+    // Frame the next drawFrame renders, the scene advances at a fixed 60 Hz step from it
+    void        setFrameIndex(uint64_t frame) { frameIndex = frame; }
+    uint64_t    getFrameIndex() const { return frameIndex; }
+
+    // Headless views copy their image to host memory every frame, must be set before createSwapChain
+    void enableReadback(bool enable) { readback = enable; }
+    void copyViewPixels(size_t viewIdx, std::vector<uint8_t>& pixels) const;
+
+    // Multisampling with the highest sample count the device supports up to the cap, 1 turns it off.
+    // Must be set before selectFormats/createSwapChain
+    void                    setMsaaSamples(uint32_t cap) { msaaCap = cap; }
+    VkSampleCountFlagBits   getMsaaSamples() const { return msaaSamples; }
+
+    // Must be set before createSwapChain
+    void                            setDynamicResolution(const DynamicResolutionSettings& settings) { drs = settings; }
+    const DynamicResolutionSettings& getDynamicResolution() const { return drs; }
+    std::vector<ResolutionSample>   getResolutionTelemetry() const;
+
+    // Frame captures: every drawFrame between start and stop is recorded to the file.
+    // replayFrame issues a captured frame again, on views with the extents of the capture
+    void startCapture(const std::string& path);
+    void stopCapture();
+    bool isCapturing() const { return recorder.isRecording(); }
+    void checkCaptureCompatible(const FrameCapture& capture) const;
+    void replayFrame(const CapturedFrame& frame);
+
+    // Compute only use: without any view there is no surface nor swap chain, createInstance, setupDebugMessenger,
+    // pickPhysicalDevice, createLogicalDevice and createCommandPool are all that's needed
+    VkPhysicalDevice    getPhysicalDevice() const { return physicalDevice; }
+    VkQueue             getQueue() const { return graphicsQueue; }
+    VkCommandPool       getCommandPool() const { return commandPool; }
+    VkShaderModule      loadShaderModule(const std::string& path) const;
+    GpuBuffer           createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags props) const;
+    void                destroyBuffer(GpuBuffer& buffer) const;
+
+    // Severities and types of the validation messages. Can be changed at any time, the messenger is recreated
+    void                setDebugFilter(const DebugFilter& filter);
+    const DebugSink&    getDebugSink() const { return *debugSink; }
+
     void destroyDebugMessenger() const;
     void cleanup();
 
@@ -64,61 +284,181 @@ private:
 
     bool checkValidationLayerSupport() const;
     bool checkDeviceExtensionSupport(const VkPhysicalDevice& device_) const;
-    bool isDeviceSuitable(const VkPhysicalDevice& device) const;
+    bool isDeviceSuitable(const VkPhysicalDevice& device, QueueFamilyIndices& idx, std::vector<SwapChainSupportDetails>& supports) const;
+    bool hasWindows() const;
+    std::vector<const char*> requiredDeviceExtensions() const;
+    DeviceCapabilities queryDeviceCapabilities(const VkPhysicalDevice& device) const;
 
     void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& info);
 
     VkSurfaceFormatKHR  chooseSwapChainSurfaceFormat(const SwapChainSupportDetails& details);
     VkPresentModeKHR    chooseSwapPresentMode(const SwapChainSupportDetails& details);
-    VkExtent2D          chooseSwapExtent(const SwapChainSupportDetails& details);
+    VkExtent2D          chooseSwapExtent(const SwapChainSupportDetails& details, GLFWwindow* window);
     VkShaderModule      createShaderModule(const std::vector<char>& code) const;
+    VkShaderModule      cachedShaderModule(const std::string& path);
+    VkPipeline          buildTrianglePipeline(uint32_t variant);
+    VkPipeline          buildClassicPipeline(uint32_t variant);
+    VkPipeline          buildMeshletPipeline(uint32_t variant);
+    VkPipeline*         pipelineVariantSlot(CapturePipeline pipeline, uint32_t features);
+    void                compilePipelineVariant(CapturePipeline pipeline, uint32_t features, bool onFirstUse);
+    VkPipeline          buildGraphicsPipeline(const VkPipelineShaderStageCreateInfo* stages,
+        uint32_t stageCount,
+        const VkPipelineVertexInputStateCreateInfo* vtxInput,
+        VkFrontFace frontFace,
+        VkPipelineLayout pipeLayout,
+        bool depthTest = false) const;
+
+    uint32_t        findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags props) const;
+    GpuBuffer       createDeviceLocalBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage);
+    VkCommandBuffer beginSingleTimeCommands() const;
+    void            endSingleTimeCommands(VkCommandBuffer cmd) const;
+    GpuImage        createImage(VkExtent2D extent, VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect) const;
+    void            destroyImage(GpuImage& image) const;
 
-    SwapChainSupportDetails querySwapChainSupport(const VkPhysicalDevice device) const;
+    SwapChainSupportDetails querySwapChainSupport(const VkPhysicalDevice device, VkSurfaceKHR surface) const;
     QueueFamilyIndices      findQueueFamily(const VkPhysicalDevice& device) const;
 
-    void recordCommandBuffer(uint32_t imgIdx);
-    void transitionImgLayout(uint32_t imgIdx,
+    void recordCommandBuffer(RenderView& view);
+    VkPipelineStageFlags2 outputStage() const;
+    void createRenderTargets();
+    void readTimestamps(RenderView& view);
+    void traceGpuPass(VkCommandBuffer cmd, RenderView& view, GpuPass pass, bool end);
+    void readGpuTrace(RenderView& view);
+    void updateResolutionScale(RenderView& view, float gpuMs);
+    void recordMeshletCulling(VkCommandBuffer cmd, VkExtent2D extent);
+
+    // Frame commands, recorded when a capture is running (see FrameCapture.h)
+    template <typename T>
+    void        record(FrameOp op, const T& payload);
+    void        record(FrameOp op);
+    VkImage     resolveImage(uint32_t viewIdx, CaptureImage image) const;
+    VkPipeline  resolvePipeline(CapturePipeline pipeline, uint32_t features);
+    void        cmdImageBarrier(VkCommandBuffer cmd, CmdImageBarrier barrier);
+    void        cmdMemoryBarrier(VkCommandBuffer cmd, const CmdMemoryBarrier& barrier);
+    void        cmdBeginRendering(VkCommandBuffer cmd, const CmdBeginRendering& begin);
+    void        cmdEndRendering(VkCommandBuffer cmd);
+    void        cmdBindPipeline(VkCommandBuffer cmd, const CmdBindPipeline& bind);
+    void        cmdBindMeshletSet(VkCommandBuffer cmd, const CmdBindPipeline& bind);
+    void        cmdBindMeshBuffers(VkCommandBuffer cmd);
+    void        cmdPushConstants(VkCommandBuffer cmd, const MeshPushConstants& pc);
+    void        cmdDraw(VkCommandBuffer cmd, FrameOp op, const CmdDraw& draw);
+    void        cmdTimestamp(VkCommandBuffer cmd, FrameOp op, const CmdTimestamp& timestamp);
+    void        cmdBlit(VkCommandBuffer cmd, const CmdBlit& blit);
+    void        cmdCopyToReadback(VkCommandBuffer cmd, const CmdBeginView& copy);
+
+    void recordMeshletScene(VkCommandBuffer cmd, VkExtent2D extent);
+
+    MeshPushConstants   sceneConstants(VkExtent2D extent) const;
+    VkShaderStageFlags  meshletStages() const;
+    void transitionImgLayout(VkCommandBuffer cmd,
+        VkImage image,
         VkImageLayout oldLayout,
         VkImageLayout newLayout,
         VkAccessFlags2 srcAM,
         VkAccessFlags2 dstAM,
         VkPipelineStageFlags2 srcSM,
-        VkPipelineStageFlags2 dstSM);
+        VkPipelineStageFlags2 dstSM,
+        VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT);
+
+    bool glfwInitialized = false;
+
+    std::vector<RenderView> views;
 
-    GLFWwindow* window = nullptr;
-    
     VkInstance instance = nullptr;
     
-    VkDebugUtilsMessengerEXT debugMessenger = nullptr;
+    VkDebugUtilsMessengerEXT    debugMessenger = nullptr;
+    std::unique_ptr<DebugSink>  debugSink = std::make_unique<DebugSink>();   // Stable address for the callback
     
     VkPhysicalDevice            physicalDevice = VK_NULL_HANDLE;
     VkPhysicalDeviceFeatures    deviceFeatures{};
+    DeviceCapabilities          capabilities;
+    QueueFamilyIndices          queueFamilies;  // Cached at device creation
+    std::string                 deviceOverride;
     
     VkDevice device{};
     
     VkQueue graphicsQueue = nullptr;
     VkQueue presentQueue = nullptr;
-    
-    VkSurfaceKHR surface = nullptr;
-    
-    VkSwapchainKHR swapChain = nullptr;
-    
-    VkExtent2D mExtent{};
-    VkFormat   mFormat{};
+
+    VkFormat mFormat{};     // Color format of every view, the pipelines are built once for it
+    VkFormat depthFormat = VK_FORMAT_UNDEFINED;     // Meshlet scene only
+    bool     formatsSelected = false;
+
+    uint32_t                msaaCap     = 1;
+    VkSampleCountFlagBits   msaaSamples = VK_SAMPLE_COUNT_1_BIT;    // Of every graphics pipeline and scene attachment
     
     VkShaderModule vShadMod = nullptr;
     VkShaderModule fShadMod = nullptr;
     
-    VkPipelineLayout    layout           = nullptr;
-    VkPipeline          graphicsPipeline = nullptr;
+    VkPipelineLayout            layout = nullptr;
+    VariantTable<FragShader>    trianglePipelines{};
+
+    // Shader variants
+    struct CompiledVariant
+    {
+        const char* pipeline    = "";
+        uint32_t    features    = 0;
+        double      ms          = 0.0;
+        bool        onFirstUse  = false;
+    };
+    uint32_t                                            shaderFeatures = 0;
+    std::vector<CompiledVariant>                        compiledVariants;
+    std::vector<std::pair<std::string, VkShaderModule>> shaderModules;     // Scene shaders, by path
 
     VkCommandPool   commandPool     = nullptr;
-    VkCommandBuffer commandBuffer   = nullptr;
+    VkFence         drawFence       = nullptr;  // Signaled when every view of the frame is done
+    FrameArena      frameArena;                 // Transient structs of drawFrame, reset every frame
+    SubmitScheduler scheduler;                  // Batches the submits and presents of the frame
+    RenderTargetPool renderTargets;             // Depth and dynamic resolution targets of the views
+
+    // Meshlet scene
+    bool        meshletScene    = false;
+    bool        uncappedPresent = false;
+    RenderPath  meshletPath     = RenderPath::Classic;  // Best path the picked device supports
+    RenderPath  renderPath      = RenderPath::Classic;  // Path currently in use
+
+    PFN_vkCmdDrawMeshTasksEXT pfnCmdDrawMeshTasks = nullptr;
+
+    // Geometry from prepareMeshletScene, released once uploaded
+    std::vector<MeshVertex> sceneVertices;
+    std::vector<uint32_t>   sceneIndices;
+    MeshletMesh             sceneMesh;
+
+    GpuBuffer vertexBuffer;
+    GpuBuffer indexBuffer;
+    GpuBuffer meshletBuffer;
+    GpuBuffer boundsBuffer;
+    GpuBuffer meshletVtxBuffer;
+    GpuBuffer meshletTriBuffer;
+    GpuBuffer indirectBuffer;
+    uint32_t  indexCount   = 0;
+    uint32_t  meshletCount = 0;
+
+    VkDescriptorSetLayout   meshletSetLayout    = nullptr;
+    VkDescriptorPool        meshletPool         = nullptr;
+    VkDescriptorSet         meshletSet          = nullptr;
+    VkPipelineLayout        meshLayout          = nullptr;
+    VariantTable<FragShader> classicPipelines{};
+    VariantTable<FragShader> meshletPipelines{};            // Task + mesh, or vertex pulling
+    VkPipeline              cullPipeline        = nullptr;  // Compute fallback only
+
+    float       sceneTime   = 0.f;
+    uint64_t    frameIndex  = 0;
+    bool        readback    = false;
+
+    // Dynamic resolution
+    DynamicResolutionSettings       drs;
+    VkQueryPool                     timestampPool = nullptr;    // 2 queries per view
+    std::vector<ResolutionSample>   telemetry;                  // Ring buffer of the last samples
+    size_t                          telemetryCount = 0;
 
-    VkSemaphore presentComplete = nullptr;
-    VkSemaphore renderFinished  = nullptr;
-    VkFence     drawFence       = nullptr;
+    // Tracing, GPU ranges are only written on frames recorded while the trace is enabled
+    VkQueryPool tracePool       = nullptr;  // 2 queries per GpuPass and view
+    bool        traceGpu        = false;    // Trace enabled when the current frame was recorded
+    int64_t     gpuTraceOffset  = 0;        // GPU clock (ns) to trace clock
+    bool        gpuTraceSynced  = false;
 
-    std::vector<VkImage>        swapChainImages;
-    std::vector<VkImageView>    SCImageView;
+    // Frame captures
+    FrameRecorder               recorder;
+    std::vector<CaptureUpload>  uploads;    // Every createDeviceLocalBuffer, in order
 };
\ No newline at end of file
@@ -1,19 +1,819 @@
 #include "VulkanSetUp.h"
+#include "RenderFarm.h"
+#include "AllocationCounter.h"
+#include "ComputeBatch.h"
+#include "Trace.h"
+#include "SceneGraph.h"
+#include "InitScheduler.h"
+#include "ResourceTracker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <random>
 
 int WIDTH  = 800;
 int HEIGHT = 600;
 
+// Default of --validation
 #ifdef NDEBUG
-const bool enableValidationLayers = false;
+bool enableValidationLayers = false;
 #else
-const bool enableValidationLayers = true;
+bool enableValidationLayers = true;
 #endif
 
+// Command line options
+struct AppOptions
+{
+    bool meshlets      = false;    // --meshlets: draw the meshlet scene instead of the triangle
+    bool benchMeshlets = false;    // --bench-meshlets: time the classic path against the meshlet path and exit
+    bool benchScene    = false;    // --bench-scene: time the scene graph updates, SoA against AoS, and exit
+
+    std::string device;             // --device <name|uuid|index>: GPU to use instead of the best scored one
+    bool        listDevices = false;    // --list-devices: print the GPUs with their score and UUID and exit
+
+    unsigned windows  = 1;          // --windows <n>: windows driven by the same device
+    unsigned headless = 0;          // --headless <n>: offscreen views rendered along with the windows
+
+    uint32_t    farmFrames  = 0;    // --farm <frames>: render the frames headless on every GPU and exit
+    unsigned    farmWorkers = 1;    // --farm-workers <n>: logical devices per GPU
+    std::string farmOut;            // --farm-out <dir>: write the farm frames as .ppm files
+
+    float       drsTargetMs = 0.f;  // --drs <ms>: dynamic resolution aiming for this GPU time per view
+    float       drsMinScale = 0.5f; // --drs-min <scale>: lowest per axis resolution scale
+    std::string drsLog;             // --drs-log <file>: write the resolution telemetry as .csv on exit
+
+    uint32_t    allocCheckFrames = 0;   // --alloc-check <frames>: fail if a steady state frame allocates
+
+    std::string captureFile;        // --capture <file>: record every frame to the file
+    std::string replayFile;         // --replay <file>: replay a capture headless at full speed and exit
+    unsigned    replayLoops = 1;    // --replay-loops <n>: times the capture is replayed
+
+    unsigned    computeMiB     = 0;     // --compute <MiB>: run the compute kernels over this much data and exit
+    unsigned    computeTileMiB = 16;    // --compute-tile <MiB>: size of the tiles streamed through the GPU
+
+    DebugFilter debugFilter;        // --validation <off|error|warning|info|verbose>, --validation-types <general,validation,performance>
+
+    std::string traceFile;          // --trace <file>: trace from the start, F9 toggles it in the window (trace.json by default)
+
+    uint32_t    msaaSamples = 1;        // --msaa <samples>: multisampling, with the highest count the device supports up to this
+    bool        benchMsaa   = false;    // --bench-msaa: time the meshlet scene headless at every sample count and exit
+
+    bool        serialInit = false; // --serial-init: run the startup steps one after the other, to compare with the overlapped startup
+
+    uint32_t    shaderFeatures = 0;         // --features <lighting,dither>: shader.frag features of the pipelines
+    bool        shaderVariants = false;     // --shader-variants: compile every allowed pipeline variant, report their cost and exit
+
+    uint64_t    soakFrames = 0;     // --soak <frames>: render headless, fail if the objects, host memory or frame time keep growing
+};
+
+static const char* renderPathName(RenderPath path)
+{
+    switch (path)
+    {
+    case RenderPath::Classic:        return "classic vertex";
+    case RenderPath::MeshletTask:    return "meshlet task/mesh shader";
+    case RenderPath::MeshletCompute: return "meshlet compute + indirect";
+    }
+
+    return "unknown";
+}
+
+// Lowest severity to report, or off. False if the level is unknown
+static bool parseValidationLevel(const char* level, DebugFilter& filter)
+{
+    const std::pair<const char*, VkDebugUtilsMessageSeverityFlagsEXT> levels[] = {
+        { "error",   VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT },
+        { "warning", VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT },
+        { "info",    VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT },
+        { "verbose", VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT },
+    };
+
+    if (strcmp(level, "off") == 0)
+    {
+        enableValidationLayers = false;
+        return true;
+    }
+
+    VkDebugUtilsMessageSeverityFlagsEXT severities = 0;
+    for (const auto& [name, bit] : levels)
+    {
+        severities |= bit;
+        if (strcmp(level, name) == 0)
+        {
+            filter.severities      = severities;
+            enableValidationLayers = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Comma separated message types
+static void parseValidationTypes(const std::string& list, DebugFilter& filter)
+{
+    filter.types = 0;
+    if (list.find("general") != std::string::npos)
+        filter.types |= VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT;
+    if (list.find("validation") != std::string::npos)
+        filter.types |= VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT;
+    if (list.find("performance") != std::string::npos)
+        filter.types |= VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+}
+
+static void reportDebugMessages(const VKSetUp& setUp)
+{
+    if (enableValidationLayers)
+        setUp.getDebugSink().printReport(std::cout);
+}
+
+#pragma region DEVICES
+
+static void runListDevices(const AppOptions& options)
+{
+    // Headless, the checks are the ones of a run without a window
+    VKSetUp setUp;
+    setUp.addHeadlessView(static_cast<unsigned>(WIDTH), static_cast<unsigned>(HEIGHT));
+    setUp.setDeviceOverride(options.device);
+    setUp.setDebugFilter(options.debugFilter);
+
+    setUp.createInstance(enableValidationLayers);
+    setUp.printDevices(std::cout);
+
+    setUp.cleanup();
+}
+
+#pragma endregion
+
+#pragma region RENDER FARM
+
+static void writePPM(const std::string& path, const std::vector<uint8_t>& rgba, unsigned width, unsigned height)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open())
+        throw std::runtime_error("failed to open " + path);
+
+    file << "P6\n" << width << " " << height << "\n255\n";
+    for (size_t i = 0; i + 3 < rgba.size(); i += 4)
+        file.write(reinterpret_cast<const char*>(&rgba[i]), 3);
+}
+
+static void runRenderFarm(const AppOptions& options)
+{
+    unsigned width  = static_cast<unsigned>(WIDTH);
+    unsigned height = static_cast<unsigned>(HEIGHT);
+
+    RenderFarm farm(width, height, enableValidationLayers, options.debugFilter, options.meshlets, options.farmWorkers);
+
+    farm.run(options.farmFrames, [&](uint32_t frame, const std::vector<uint8_t>& pixels)
+    {
+        if (options.farmOut.empty())
+            return;
+
+        char name[32];
+        snprintf(name, sizeof(name), "/frame_%05u.ppm", frame);
+        writePPM(options.farmOut + name, pixels, width, height);
+    });
+
+    farm.printReport();
+}
+
+#pragma endregion
+
+#pragma region COMPUTE BATCH
+
+static void runComputeBatch(const AppOptions& options)
+{
+    // Same device bootstrap as the renderer, without any view
+    VKSetUp setUp;
+    setUp.setDeviceOverride(options.device);
+    setUp.setDebugFilter(options.debugFilter);
+    setUp.createInstance(enableValidationLayers);
+    setUp.setupDebugMessenger(enableValidationLayers);
+    setUp.pickPhysicalDevice();
+    setUp.createLogicalDevice();
+    setUp.createCommandPool();
+
+    try
+    {
+        ComputeBatch batch(setUp, static_cast<VkDeviceSize>(options.computeTileMiB) << 20);
+
+        bool allMatch = true;
+        for (size_t k = 0; k < static_cast<size_t>(ComputeKernel::Count); k++)
+        {
+            ComputeKernel kernel = static_cast<ComputeKernel>(k);
+            ComputeRunResult result = batch.run(kernel, static_cast<VkDeviceSize>(options.computeMiB) << 20);
+
+            double gb = static_cast<double>(result.bytes) / 1e9;
+            std::cout << ComputeBatch::kernelName(kernel) << ": " << (result.bytes >> 20) << " MiB in " << result.tiles << " tiles, "
+                << "GPU " << result.gpuMs << " ms (" << gb / (result.gpuMs / 1000.0) << " GB/s), "
+                << "CPU " << result.cpuMs << " ms (" << gb / (result.cpuMs / 1000.0) << " GB/s), "
+                << (result.match ? "results match" : "RESULTS DIFFER") << std::endl;
+
+            allMatch = allMatch && result.match;
+        }
+
+        if (!allMatch)
+            throw std::runtime_error("compute batch: the GPU results don't match the CPU reference");
+    }
+    catch (...)
+    {
+        if (enableValidationLayers)
+            setUp.destroyDebugMessenger();
+        setUp.cleanup();
+        throw;
+    }
+
+    if (enableValidationLayers)
+        setUp.destroyDebugMessenger();
+    setUp.cleanup();
+    reportDebugMessages(setUp);
+}
+
+#pragma endregion
+
+#pragma region SCENE BENCHMARK
+
+// Baseline for the scene graph: the same hierarchy and updates with one struct per node
+struct AosNode
+{
+    glm::vec3   translation;
+    glm::quat   rotation;
+    glm::vec3   scale;
+    uint32_t    parent;
+    uint32_t    subtreeEnd;
+    glm::vec4   localSphere;
+    glm::mat4   world;
+    glm::vec4   worldSphere;
+    uint8_t     lod;
+};
+
+static void updateAosNode(std::vector<AosNode>& nodes, uint32_t i, SceneInstance* instances)
+{
+    AosNode& node = nodes[i];
+
+    glm::mat4 local = glm::mat4_cast(node.rotation);
+    local[0] *= node.scale.x;
+    local[1] *= node.scale.y;
+    local[2] *= node.scale.z;
+    local[3]  = glm::vec4(node.translation, 1.f);
+
+    node.world = node.parent == NO_PARENT ? local : nodes[node.parent].world * local;
+
+    glm::vec4 center = node.world * glm::vec4(glm::vec3(node.localSphere), 1.f);
+    float maxScale = std::sqrt(std::max({ glm::dot(node.world[0], node.world[0]), glm::dot(node.world[1], node.world[1]), glm::dot(node.world[2], node.world[2]) }));
+    node.worldSphere = glm::vec4(glm::vec3(center), node.localSphere.w * maxScale);
+
+    instances[i].world  = node.world;
+    instances[i].sphere = node.worldSphere;
+    instances[i].lod    = node.lod;
+}
+
+// Random depth first tree, each node is a child of the previous one or of one of its ancestors
+static std::vector<uint32_t> generateHierarchy(uint32_t count, std::mt19937& rng)
+{
+    std::vector<uint32_t> parents;
+    std::vector<uint32_t> path;
+    parents.reserve(count);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (i == 0)
+        {
+            parents.push_back(NO_PARENT);
+            path.push_back(0);
+            continue;
+        }
+
+        // Going deeper stops at 8 levels, the fanouts end up in the tens
+        size_t keep = path.size() < 8 && rng() % 2 ? path.size() : 1 + rng() % path.size();
+        path.resize(keep);
+        parents.push_back(path.back());
+        path.push_back(i);
+    }
+
+    return parents;
+}
+
+static void runSceneBenchmark(const AppOptions& options)
+{
+    const uint32_t sizes[]      = { 10000, 100000, 1000000 };
+    const float    lods[]       = { 0.1f, 0.03f, 0.01f };
+    const uint32_t lodCount     = static_cast<uint32_t>(std::size(lods));
+
+    // The instances go to host visible memory, like they would for the renderer
+    VKSetUp setUp;
+    setUp.setDeviceOverride(options.device);
+    setUp.setDebugFilter(options.debugFilter);
+    setUp.createInstance(enableValidationLayers);
+    setUp.setupDebugMessenger(enableValidationLayers);
+    setUp.pickPhysicalDevice();
+    setUp.createLogicalDevice();
+
+    VkDeviceSize bufferSize = sizeof(SceneInstance) * sizes[std::size(sizes) - 1];
+    GpuBuffer instanceBuffer = setUp.createBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    void* mapped = nullptr;
+    vkMapMemory(setUp.getDevice(), instanceBuffer.memory, 0, bufferSize, 0, &mapped);
+    SceneInstance* instances = static_cast<SceneInstance*>(mapped);
+
+    auto timeMs = [](int iterations, auto&& body)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; i++)
+            body(i);
+        auto end = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+    };
+
+    for (uint32_t count : sizes)
+    {
+        std::mt19937 rng(count);
+        std::vector<uint32_t> parents = generateHierarchy(count, rng);
+        int iterations = std::clamp(static_cast<int>(2000000 / count), 5, 200);
+
+        // Same nodes moved on every layout: 1% of them per iteration
+        std::vector<uint32_t> moved(count / 100 * static_cast<size_t>(iterations));
+        for (auto& node : moved)
+            node = rng() % count;
+        size_t movedPerIteration = count / 100;
+
+        SceneGraph single(1);
+        SceneGraph parallel;
+        std::vector<AosNode> aos(count);
+        for (SceneGraph* graph : { &single, &parallel })
+            graph->reserve(count);
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            glm::vec3 translation(static_cast<float>(rng() % 100) * 0.01f, 0.f, 1.f);
+            glm::quat rotation = glm::angleAxis(static_cast<float>(rng() % 628) * 0.01f, glm::vec3(0.f, 1.f, 0.f));
+            glm::vec3 scale(0.9f);
+            glm::vec4 sphere(0.f, 0.f, 0.f, 0.5f);
+
+            for (SceneGraph* graph : { &single, &parallel })
+                graph->addNode(parents[i], translation, rotation, scale, sphere);
+
+            aos[i] = { translation, rotation, scale, parents[i], 0, sphere, glm::mat4(1.f), glm::vec4(0.f), 0 };
+        }
+
+        // Final once the whole tree is there
+        for (uint32_t i = 0; i < count; i++)
+            aos[i].subtreeEnd = single.getSubtreeEnd(i);
+
+        // Every node: the root moves
+        auto aosFull = timeMs(iterations, [&](int it)
+        {
+            aos[0].translation.x = static_cast<float>(it);
+            for (uint32_t i = 0; i < count; i++)
+                updateAosNode(aos, i, instances);
+        });
+        auto soaFull = [&](SceneGraph& graph)
+        {
+            return timeMs(iterations, [&](int it)
+            {
+                graph.setTranslation(0, glm::vec3(static_cast<float>(it), 0.f, 1.f));
+                graph.update(instances);
+            });
+        };
+        double singleFull   = soaFull(single);
+        double parallelFull = soaFull(parallel);
+
+        // Dirty subtrees only
+        auto aosDirty = timeMs(iterations, [&](int it)
+        {
+            std::vector<uint32_t> roots(moved.begin() + it * movedPerIteration, moved.begin() + (it + 1) * movedPerIteration);
+            std::sort(roots.begin(), roots.end());
+            uint32_t covered = 0;
+            for (uint32_t root : roots)
+            {
+                aos[root].translation.y += 0.01f;
+                if (root < covered)
+                    continue;
+                covered = aos[root].subtreeEnd;
+                for (uint32_t i = root; i < covered; i++)
+                    updateAosNode(aos, i, instances);
+            }
+        });
+        size_t dirtyNodes = 0;
+        auto soaDirty = [&](SceneGraph& graph)
+        {
+            dirtyNodes = 0;
+            return timeMs(iterations, [&](int it)
+            {
+                for (size_t k = 0; k < movedPerIteration; k++)
+                {
+                    uint32_t node = moved[it * movedPerIteration + k];
+                    graph.setTranslation(node, glm::vec3(0.f, 0.01f * static_cast<float>(it), 1.f));
+                }
+                dirtyNodes += graph.update(instances);
+            });
+        };
+        double singleDirty   = soaDirty(single);
+        double parallelDirty = soaDirty(parallel);
+
+        // LOD selection from the world bounds
+        glm::vec3 camera(0.f, 2.f, -5.f);
+        auto aosLod = timeMs(iterations, [&](int)
+        {
+            for (uint32_t i = 0; i < count; i++)
+            {
+                AosNode& node = aos[i];
+                glm::vec3 d = glm::vec3(node.worldSphere) - camera;
+                float d2 = std::max(glm::dot(d, d), 1e-6f);
+                float r2 = node.worldSphere.w * node.worldSphere.w;
+
+                uint8_t level = 0;
+                for (uint32_t k = 0; k < lodCount; k++)
+                    level += r2 < lods[k] * lods[k] * d2 ? 1 : 0;
+                if (level != node.lod)
+                    instances[i].lod = level;
+                node.lod = level;
+            }
+        });
+        auto soaLod = timeMs(iterations, [&](int) { single.updateLods(camera, lods, lodCount, instances); });
+
+        std::cout << "scene graph, " << count << " nodes (" << iterations << " iterations):" << std::endl;
+        std::cout << "  full update:  AoS " << aosFull << " ms, SoA " << singleFull << " ms, SoA on "
+            << parallel.getThreadCount() << " threads " << parallelFull << " ms" << std::endl;
+        std::cout << "  1% moved (" << dirtyNodes / iterations << " nodes in the dirty subtrees): AoS " << aosDirty << " ms, SoA "
+            << singleDirty << " ms, SoA on " << parallel.getThreadCount() << " threads " << parallelDirty << " ms" << std::endl;
+        std::cout << "  LOD selection: AoS " << aosLod << " ms, SoA " << soaLod << " ms" << std::endl;
+    }
+
+    vkUnmapMemory(setUp.getDevice(), instanceBuffer.memory);
+    setUp.destroyBuffer(instanceBuffer);
+    if (enableValidationLayers)
+        setUp.destroyDebugMessenger();
+    setUp.cleanup();
+    reportDebugMessages(setUp);
+}
+
+#pragma endregion
+
+#pragma region MSAA BENCHMARK
+
+static void runMsaaBenchmark(const AppOptions& options)
+{
+    const int warmupFrames = 60;
+    const int benchFrames  = 600;
+
+    unsigned width  = static_cast<unsigned>(WIDTH);
+    unsigned height = static_cast<unsigned>(HEIGHT);
+    auto mib = [](double bytes) { return bytes / (1024.0 * 1024.0); };
+
+    // Every sample count the device supports, each on its own device so the targets and pipelines are rebuilt.
+    // Only 1x and 4x are guaranteed, so a missing count is skipped, not the end of the list. The counts
+    // are known once the 1x run picked the device
+    VkSampleCountFlags sampleCounts = VK_SAMPLE_COUNT_1_BIT;
+    for (uint32_t samples = 1; samples <= 64; samples *= 2)
+    {
+        if (!(sampleCounts & samples))
+            continue;
+
+        VKSetUp setUp;
+        setUp.addHeadlessView(width, height);
+        setUp.enableMeshletScene(true);     // Depth and enough triangle edges for the samples to matter
+        setUp.setMsaaSamples(samples);
+        setUp.setDeviceOverride(options.device);
+        setUp.setDebugFilter(options.debugFilter);
+
+        setUp.createInstance(enableValidationLayers);
+        setUp.setupDebugMessenger(enableValidationLayers);
+        setUp.pickPhysicalDevice();
+        setUp.createLogicalDevice();
+        setUp.createSwapChain();
+        setUp.createImageViews();
+        setUp.createGraphicsPipeline();
+        setUp.createCommandPool();
+        setUp.createCommandBuffer();
+        setUp.createSyncObjs();
+        setUp.createMeshletScene();
+
+        sampleCounts = setUp.getCapabilities().sampleCounts;
+
+        // The cap fell back to a lower count, the color or depth format can't have this one
+        if (setUp.getMsaaSamples() == samples)
+        {
+            for (int i = 0; i < warmupFrames; i++)
+                setUp.drawFrame();
+            vkDeviceWaitIdle(setUp.getDevice());
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < benchFrames; i++)
+                setUp.drawFrame();
+            vkDeviceWaitIdle(setUp.getDevice());
+            auto end = std::chrono::high_resolution_clock::now();
+
+            // Estimated attachment traffic, not measured. Model of a tile based GPU, 4 bytes per color
+            // and depth sample: the resolve in the pass writes the resolved color only, the samples and
+            // the depth stay on chip (DONT_CARE). Storing the samples instead writes every color and depth
+            // sample, then a separate resolve reads the color samples back and writes the resolved pixels.
+            // An immediate mode GPU moves the samples through its caches either way, there the footprint
+            // and the frame time are the figures to look at
+            double pixelBytes    = static_cast<double>(width) * height * 4;
+            double resolvedBytes = pixelBytes;
+            double storedBytes   = samples > 1 ? pixelBytes * samples * 3 + pixelBytes : pixelBytes;
+
+            double ms = std::chrono::duration<double, std::milli>(end - start).count() / benchFrames;
+            RenderTargetPool::Footprint footprint = setUp.getRenderTargets().getFootprint();
+
+            std::cout << "msaa " << samples << "x: " << ms << " ms/frame, targets " << mib(static_cast<double>(footprint.allocated)) << " MiB";
+            if (footprint.lazy)
+                std::cout << " (" << mib(static_cast<double>(footprint.lazyCommitted)) << " MiB committed)";
+            std::cout << ", estimated " << mib(resolvedBytes) << " MiB/frame of attachment traffic with the in-pass resolve, "
+                << mib(storedBytes) << " MiB/frame with stored samples" << std::endl;
+        }
+
+        if (enableValidationLayers)
+            setUp.destroyDebugMessenger();
+        setUp.cleanup();
+        reportDebugMessages(setUp);
+    }
+}
+
+#pragma endregion
+
+#pragma region SHADER VARIANTS
+
+static void runShaderVariants(const AppOptions& options)
+{
+    // Headless with the meshlet scene, so every pipeline that has variants exists
+    VKSetUp setUp;
+    setUp.addHeadlessView(static_cast<unsigned>(WIDTH), static_cast<unsigned>(HEIGHT));
+    setUp.enableMeshletScene(true);
+    setUp.setDeviceOverride(options.device);
+    setUp.setDebugFilter(options.debugFilter);
+    setUp.setShaderFeatures(options.shaderFeatures);
+
+    setUp.createInstance(enableValidationLayers);
+    setUp.setupDebugMessenger(enableValidationLayers);
+    setUp.pickPhysicalDevice();
+    setUp.createLogicalDevice();
+    setUp.createSwapChain();
+    setUp.createImageViews();
+    setUp.createGraphicsPipeline();
+    setUp.createCommandPool();
+    setUp.createCommandBuffer();
+    setUp.createSyncObjs();
+    setUp.createMeshletScene();
+
+    setUp.compileAllVariants();
+    setUp.printShaderVariantReport(std::cout);
+
+    if (enableValidationLayers)
+        setUp.destroyDebugMessenger();
+    setUp.cleanup();
+    reportDebugMessages(setUp);
+}
+
+#pragma endregion
+
+#pragma region SOAK TEST
+
+// What a window of the soak test ended with
+struct SoakWindow
+{
+    uint64_t                frame;
+    double                  msPerFrame;
+    ResourceTracker::Counts counts;
+    int64_t                 traceBytes;     // Collected trace events, apart from the driver memory
+};
+
+static void runSoakTest(const AppOptions& options)
+{
+    const uint64_t windowCount  = 20;
+    const uint64_t warmupFrames = std::min<uint64_t>(1000, options.soakFrames / 10);
+    const int64_t  hostSlack    = 64 * 1024;    // Driver caches that settle late, in bytes
+    const double   slowdown     = 1.25;         // Frame time ratio that counts as a slowdown
+
+    auto kib = [](int64_t bytes) { return static_cast<double>(bytes) / 1024.0; };
+
+    ResourceTracker::Counts before = ResourceTracker::snapshot();
+
+    // The scene, samples and shader features of the run that is being soaked
+    VKSetUp setUp;
+    setUp.addHeadlessView(static_cast<unsigned>(WIDTH), static_cast<unsigned>(HEIGHT));
+    setUp.enableMeshletScene(options.meshlets);
+    setUp.setMsaaSamples(options.msaaSamples);
+    setUp.setShaderFeatures(options.shaderFeatures);
+    setUp.setDeviceOverride(options.device);
+    setUp.setDebugFilter(options.debugFilter);
+
+    setUp.createInstance(enableValidationLayers);
+    setUp.setupDebugMessenger(enableValidationLayers);
+    setUp.pickPhysicalDevice();
+    setUp.createLogicalDevice();
+    setUp.createSwapChain();
+    setUp.createImageViews();
+    setUp.createGraphicsPipeline();
+    setUp.createCommandPool();
+    setUp.createCommandBuffer();
+    setUp.createSyncObjs();
+    setUp.createMeshletScene();
+
+    // Pipelines compiled on first use and the driver caches are in place after the warmup
+    uint64_t frame = 0;
+    for (; frame < warmupFrames; frame++)
+        setUp.drawFrame();
+    vkDeviceWaitIdle(setUp.getDevice());
+
+    ResourceTracker::Counts baseline = ResourceTracker::snapshot();
+    std::cout << "soak: " << options.soakFrames << " frames after " << warmupFrames << " warmup frames, steady state:" << std::endl;
+    ResourceTracker::printReport(std::cout, baseline);
+
+    uint64_t windowFrames = std::max<uint64_t>(1, (options.soakFrames - warmupFrames) / windowCount);
+    std::vector<SoakWindow> windows;
+    while (frame + windowFrames <= options.soakFrames)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (uint64_t i = 0; i < windowFrames; i++, frame++)
+            setUp.drawFrame();
+        vkDeviceWaitIdle(setUp.getDevice());
+        auto end = std::chrono::high_resolution_clock::now();
+
+        // Keeps the trace rings from filling up over days, the collected events stay under their cap
+        if (Trace::isEnabled())
+            Trace::collect();
+
+        SoakWindow window{ frame, std::chrono::duration<double, std::milli>(end - start).count() / static_cast<double>(windowFrames),
+            ResourceTracker::snapshot(), static_cast<int64_t>(Trace::collectedBytes()) };
+        std::cout << "soak: frame " << frame << ", " << window.msPerFrame << " ms/frame, " << window.counts.liveObjects()
+            << " objects, device " << kib(window.counts.deviceBytes) << " KiB, host " << kib(window.counts.hostBytes)
+            << " KiB, trace " << kib(window.traceBytes) << " KiB" << std::endl;
+        windows.push_back(std::move(window));
+    }
+
+    std::vector<std::string> failures;
+
+    // The steady state frame creates nothing, a single object more is a leak
+    for (const auto& window : windows)
+    {
+        if (window.counts.objects != baseline.objects || window.counts.deviceBytes != baseline.deviceBytes)
+        {
+            failures.push_back("live objects changed by frame " + std::to_string(window.frame));
+            ResourceTracker::printReport(std::cout, window.counts);
+            break;
+        }
+    }
+
+    // The trace fills up to its cap on a long enough run and then stays there, it only fails past it
+    int64_t traceCap = static_cast<int64_t>(Trace::collectedCapacityBytes());
+    for (const auto& window : windows)
+    {
+        if (window.traceBytes > traceCap)
+        {
+            failures.push_back("trace grew to " + std::to_string(window.traceBytes / 1024) + " KiB by frame "
+                + std::to_string(window.frame) + ", over its " + std::to_string(traceCap / 1024) + " KiB cap");
+            break;
+        }
+    }
+
+    // Growth that keeps going: the lowest of the last quarter is above the highest of the first half,
+    // for the host memory and the frame time alike. Anything that plateaus, a cache or a pool that
+    // grows once, doesn't trip it, and neither does a single noisy window
+    if (windows.size() >= 4)
+    {
+        size_t half    = windows.size() / 2;
+        size_t quarter = windows.size() - windows.size() / 4;
+
+        int64_t earlyHost = 0;
+        double  earlyMs   = 0.0;
+        for (size_t i = 0; i < half; i++)
+        {
+            earlyHost = std::max(earlyHost, windows[i].counts.hostBytes);
+            earlyMs   = std::max(earlyMs, windows[i].msPerFrame);
+        }
+
+        int64_t lateHost = windows[quarter].counts.hostBytes;
+        double  lateMs   = windows[quarter].msPerFrame;
+        for (size_t i = quarter; i < windows.size(); i++)
+        {
+            lateHost = std::min(lateHost, windows[i].counts.hostBytes);
+            lateMs   = std::min(lateMs, windows[i].msPerFrame);
+        }
+
+        if (lateHost > earlyHost + hostSlack)
+            failures.push_back("host memory grew from " + std::to_string(earlyHost / 1024) + " to " + std::to_string(lateHost / 1024) + " KiB");
+        if (lateMs > earlyMs * slowdown)
+            failures.push_back("frame time grew from " + std::to_string(earlyMs) + " to " + std::to_string(lateMs) + " ms");
+    }
+
+    if (enableValidationLayers)
+        setUp.destroyDebugMessenger();
+    setUp.cleanup();
+    reportDebugMessages(setUp);
+
+    // Everything the run created is gone with the instance
+    ResourceTracker::Counts after = ResourceTracker::snapshot();
+    if (after.liveObjects() != before.liveObjects() || after.deviceBytes != before.deviceBytes || after.hostBytes != before.hostBytes)
+    {
+        failures.push_back("objects left after cleanup");
+        ResourceTracker::printReport(std::cout, after);
+    }
+
+    if (!failures.empty())
+    {
+        std::string message = "soak test failed:";
+        for (const auto& failure : failures)
+            message += "\n  " + failure;
+        throw std::runtime_error(message);
+    }
+
+    std::cout << "soak: passed, " << frame << " frames, host peak " << kib(after.hostPeakBytes) << " KiB" << std::endl;
+}
+
+#pragma endregion
+
+#pragma region REPLAY
+
+static void runReplay(const AppOptions& options)
+{
+    FrameCapture capture(options.replayFile);
+    if (capture.frames.empty())
+        throw std::runtime_error(options.replayFile + " has no frame");
+
+    // Windows are replayed as headless views of the same extent
+    VKSetUp setUp;
+    for (const auto& view : capture.views)
+        setUp.addHeadlessView(view.width, view.height);
+
+    DynamicResolutionSettings drs;
+    drs.enabled = capture.header.dynamicResolution != 0;
+    setUp.setDynamicResolution(drs);
+    setUp.enableMeshletScene(capture.header.meshletScene != 0);
+    setUp.setMsaaSamples(capture.header.msaaSamples);
+    setUp.setDeviceOverride(options.device);
+    setUp.setDebugFilter(options.debugFilter);
+
+    setUp.createInstance(enableValidationLayers);
+    setUp.setupDebugMessenger(enableValidationLayers);
+    setUp.pickPhysicalDevice();
+    setUp.createLogicalDevice();
+    setUp.createSwapChain();
+    setUp.createImageViews();
+    setUp.createGraphicsPipeline();
+    setUp.createCommandPool();
+    setUp.createCommandBuffer();
+    setUp.createSyncObjs();
+    setUp.createMeshletScene();
+    setUp.checkCaptureCompatible(capture);
+
+    // Per frame replay time, to point at the frames that got slower or faster
+    size_t frameCount = capture.frames.size();
+    std::vector<double> replayMs(frameCount, 0.0);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (unsigned loop = 0; loop < options.replayLoops; loop++)
+    {
+        for (size_t i = 0; i < frameCount; i++)
+        {
+            auto t0 = std::chrono::high_resolution_clock::now();
+            setUp.replayFrame(capture.frames[i]);
+            auto t1 = std::chrono::high_resolution_clock::now();
+            replayMs[i] += std::chrono::duration<double, std::milli>(t1 - t0).count() / options.replayLoops;
+        }
+    }
+    vkDeviceWaitIdle(setUp.getDevice());
+    auto end = std::chrono::high_resolution_clock::now();
+
+    double totalMs    = std::chrono::duration<double, std::milli>(end - start).count();
+    double capturedMs = 0.0;
+    for (const auto& frame : capture.frames)
+        capturedMs += frame.cpuMs;
+
+    std::cout << "replayed " << frameCount << " frames x " << options.replayLoops << ": "
+        << totalMs / static_cast<double>(frameCount * options.replayLoops) << " ms/frame (captured at "
+        << capturedMs / static_cast<double>(frameCount) << " ms/frame)" << std::endl;
+
+    // The slowest frames of the replay
+    std::vector<size_t> order(frameCount);
+    for (size_t i = 0; i < frameCount; i++)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return replayMs[a] > replayMs[b]; });
+    for (size_t i = 0; i < std::min<size_t>(5, frameCount); i++)
+    {
+        const CapturedFrame& frame = capture.frames[order[i]];
+        std::cout << "  frame " << frame.frameIndex << ": " << replayMs[order[i]] << " ms (captured "
+            << frame.cpuMs << " ms)" << std::endl;
+    }
+
+    if (enableValidationLayers)
+        setUp.destroyDebugMessenger();
+    setUp.cleanup();
+    reportDebugMessages(setUp);
+}
+
+#pragma endregion
+
 #pragma region HELLO TRIANGLE
 
 class HelloTriangleApplication
 {
 public:
+    explicit HelloTriangleApplication(const AppOptions& options) : mOptions(options) {}
+
     void run();
 
 private:
@@ -22,11 +822,20 @@ private:
     void mainLoop();
     void cleanup();
 
-    VKSetUp mSetUp;
+    void benchmarkMeshlets();
+    void checkFrameAllocations();
+    void reportDynamicResolution() const;
+
+    AppOptions  mOptions;
+    VKSetUp     mSetUp;
+
+    std::chrono::high_resolution_clock::time_point mStartTime;
 };
 
 void HelloTriangleApplication::run()
 {
+    mStartTime = std::chrono::high_resolution_clock::now();
+
     initWindow();
     initVulkan();
     mainLoop();
@@ -36,29 +845,96 @@ void HelloTriangleApplication::run()
 void HelloTriangleApplication::initWindow()
 {
     mSetUp.InitWindow(WIDTH, HEIGHT);
+
+    // Extra views share the device, pipelines and queue with the first window
+    for (unsigned i = 1; i < mOptions.windows; i++)
+        mSetUp.addWindow(WIDTH, HEIGHT);
+    for (unsigned i = 0; i < mOptions.headless; i++)
+        mSetUp.addHeadlessView(WIDTH, HEIGHT);
 }
 
 void HelloTriangleApplication::initVulkan()
 {
-    mSetUp.createInstance(enableValidationLayers);
-    mSetUp.setupDebugMessenger(enableValidationLayers);
-    mSetUp.createSurface();
-    mSetUp.pickPhysicalDevice();
-    mSetUp.createLogicalDevice();
-    mSetUp.createSwapChain();
-    mSetUp.createImageViews();
-    mSetUp.createGraphicsPipeline();
-    mSetUp.createCommandPool();
-    mSetUp.createCommandBuffer();
-    mSetUp.createSyncObjs();
+    mSetUp.setDebugFilter(mOptions.debugFilter);
+    mSetUp.enableMeshletScene(mOptions.meshlets || mOptions.benchMeshlets);
+    mSetUp.setUncappedPresent(mOptions.benchMeshlets);
+    mSetUp.setDeviceOverride(mOptions.device);
+
+    DynamicResolutionSettings drs;
+    drs.enabled     = mOptions.drsTargetMs > 0.f;
+    drs.targetMs    = mOptions.drsTargetMs;
+    drs.minScale    = mOptions.drsMinScale;
+    mSetUp.setDynamicResolution(drs);
+    mSetUp.setMsaaSamples(mOptions.msaaSamples);
+    mSetUp.setShaderFeatures(mOptions.shaderFeatures);
+
+    // The scene geometry is built while the device is created, the pipelines are compiled and the
+    // scene uploaded while the swap chain is created. The GLFW calls stay on this thread
+    InitScheduler init;
+    auto geometry = init.add("scene geometry", [&]() { mSetUp.prepareMeshletScene(); });
+    auto instance = init.add("instance", [&]()
+    {
+        mSetUp.createInstance(enableValidationLayers);
+        mSetUp.setupDebugMessenger(enableValidationLayers);
+    }, {}, true);
+    auto surface = init.add("surface", [&]() { mSetUp.createSurface(); }, { instance }, true);
+    auto device = init.add("device", [&]()
+    {
+        mSetUp.pickPhysicalDevice();
+        mSetUp.createLogicalDevice();
+        mSetUp.selectFormats();
+    }, { surface });
+    auto swapChain = init.add("swap chain", [&]()
+    {
+        mSetUp.createSwapChain();
+        mSetUp.createImageViews();
+    }, { device }, true);
+    auto pipelines = init.add("pipelines", [&]()
+    {
+        mSetUp.createGraphicsPipeline();
+        mSetUp.createMeshletPipelines();
+    }, { device });
+    auto commands = init.add("command buffers", [&]()
+    {
+        mSetUp.createCommandPool();
+        mSetUp.createCommandBuffer();
+    }, { device });
+    init.add("sync objects", [&]() { mSetUp.createSyncObjs(); }, { swapChain });
+    init.add("scene upload", [&]() { mSetUp.createMeshletScene(); }, { geometry, pipelines, commands });
+
+    init.run(!mOptions.serialInit);
+    init.printReport(std::cout);
+
+    if (!mOptions.captureFile.empty())
+        mSetUp.startCapture(mOptions.captureFile);
 }
 
 void HelloTriangleApplication::mainLoop()
 {
-    auto window = mSetUp.getWindow();
-    while (!glfwWindowShouldClose(mSetUp.getWindow()))
+    if (mOptions.benchMeshlets)
     {
-        glfwPollEvents();
+        benchmarkMeshlets();
+        vkDeviceWaitIdle(mSetUp.getDevice());
+        return;
+    }
+
+    if (mOptions.allocCheckFrames > 0)
+    {
+        checkFrameAllocations();
+        vkDeviceWaitIdle(mSetUp.getDevice());
+        return;
+    }
+
+    auto window   = mSetUp.getWindow();
+    bool traceKey = false;
+    while (!mSetUp.shouldClose())
+    {
+        TRACE_SCOPE("frame", "cpu", mSetUp.getFrameIndex());
+
+        {
+            TRACE_SCOPE("glfwPollEvents");
+            glfwPollEvents();
+        }
 
         glfwMakeContextCurrent(window);
         glfwGetFramebufferSize(window, &WIDTH, &HEIGHT);
@@ -66,28 +942,267 @@ void HelloTriangleApplication::mainLoop()
         if (glfwGetKey(window, GLFW_KEY_ESCAPE))
             break;
 
+        // F9 toggles the trace, on the press only
+        bool pressed = glfwGetKey(window, GLFW_KEY_F9) == GLFW_PRESS;
+        if (pressed && !traceKey)
+        {
+            Trace::setEnabled(!Trace::isEnabled());
+            std::cout << "trace " << (Trace::isEnabled() ? "on" : "off") << std::endl;
+        }
+        traceKey = pressed;
+
         mSetUp.drawFrame();
+
+        if (mSetUp.getFrameIndex() == 1)
+        {
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - mStartTime).count();
+            std::cout << "first frame submitted " << ms << " ms after startup" << std::endl;
+        }
+
+        // A few hundred frames fill the ring buffers, move the events out regularly
+        if (Trace::isEnabled() && mSetUp.getFrameIndex() % 256 == 0)
+            Trace::collect();
     }
 
     vkDeviceWaitIdle(mSetUp.getDevice());
 }
 
+void HelloTriangleApplication::benchmarkMeshlets()
+{
+    const int warmupFrames = 60;
+    const int benchFrames  = 600;
+
+    std::vector<RenderPath> paths = { RenderPath::Classic };
+    if (mSetUp.getMeshletPath() != RenderPath::Classic)
+        paths.push_back(mSetUp.getMeshletPath());
+    else
+        std::cout << "no meshlet path supported by the device, only the classic path is measured" << std::endl;
+
+    for (RenderPath path : paths)
+    {
+        mSetUp.setRenderPath(path);
+
+        for (int i = 0; i < warmupFrames; i++)
+        {
+            glfwPollEvents();
+            mSetUp.drawFrame();
+        }
+        vkDeviceWaitIdle(mSetUp.getDevice());
+
+        mSetUp.getSubmitScheduler().resetStats();
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < benchFrames; i++)
+        {
+            glfwPollEvents();
+            mSetUp.drawFrame();
+        }
+        vkDeviceWaitIdle(mSetUp.getDevice());
+        auto end = std::chrono::high_resolution_clock::now();
+
+        double ms = std::chrono::duration<double, std::milli>(end - start).count() / benchFrames;
+        const SubmitScheduler::Stats& stats = mSetUp.getSubmitScheduler().getStats();
+        double flushes = static_cast<double>(std::max<uint64_t>(stats.flushes, 1));    // 0 per frame, not nan, if nothing was flushed
+        std::cout << renderPathName(path) << ": " << ms << " ms/frame (" << 1000.0 / ms << " fps), "
+            << static_cast<double>(stats.submitCalls) / flushes << " submits and "
+            << static_cast<double>(stats.submitInfos) / flushes << " batches per frame" << std::endl;
+    }
+}
+
+void HelloTriangleApplication::checkFrameAllocations()
+{
+    // The first frames are allowed to allocate (driver warm up, lazy caches...)
+    const int warmupFrames = 60;
+
+    // The validation layers share the process' operator new on some platforms and allocate a lot
+    if (enableValidationLayers)
+        std::cout << "allocation check with validation layers enabled, their allocations may be counted" << std::endl;
+
+    for (int i = 0; i < warmupFrames; i++)
+    {
+        glfwPollEvents();
+        mSetUp.drawFrame();
+    }
+
+    uint64_t total            = 0;
+    uint32_t framesWithAllocs = 0;
+    for (uint32_t i = 0; i < mOptions.allocCheckFrames; i++)
+    {
+        glfwPollEvents();
+
+        uint64_t before = AllocationCounter::count();
+        mSetUp.drawFrame();
+        uint64_t allocs = AllocationCounter::count() - before;
+
+        total += allocs;
+        framesWithAllocs += allocs > 0 ? 1 : 0;
+    }
+
+    const FrameArena& arena = mSetUp.getFrameArena();
+    std::cout << "allocation check: " << total << " heap allocations in " << mOptions.allocCheckFrames
+        << " frames, frame arena high water " << arena.getHighWater() << "/" << arena.getCapacity() << " bytes" << std::endl;
+
+    if (total != 0)
+        throw std::runtime_error("allocation check failed: " + std::to_string(framesWithAllocs) + " frames allocated on the heap");
+}
+
+void HelloTriangleApplication::reportDynamicResolution() const
+{
+    if (!mSetUp.getDynamicResolution().enabled)
+        return;
+
+    std::vector<ResolutionSample> samples = mSetUp.getResolutionTelemetry();
+    if (samples.empty())
+        return;
+
+    float gpuMs = 0.f;
+    float scale = 0.f;
+    for (const auto& sample : samples)
+    {
+        gpuMs += sample.gpuMs;
+        scale += sample.scale;
+    }
+    std::cout << "dynamic resolution: target " << mOptions.drsTargetMs << " ms, average "
+        << gpuMs / static_cast<float>(samples.size()) << " ms at scale " << scale / static_cast<float>(samples.size())
+        << " over the last " << samples.size() << " samples" << std::endl;
+
+    if (mOptions.drsLog.empty())
+        return;
+
+    std::ofstream file(mOptions.drsLog);
+    if (!file.is_open())
+        throw std::runtime_error("failed to open " + mOptions.drsLog);
+
+    file << "frame,view,gpu_ms,scale,width,height\n";
+    for (const auto& sample : samples)
+    {
+        file << sample.frame << "," << sample.view << "," << sample.gpuMs << "," << sample.scale << ","
+            << sample.extent.width << "," << sample.extent.height << "\n";
+    }
+}
+
 void HelloTriangleApplication::cleanup()
 {
+    reportDynamicResolution();
+    mSetUp.getRenderTargets().printReport(std::cout);
+    mSetUp.printShaderVariantReport(std::cout);
+
     if (enableValidationLayers)
         mSetUp.destroyDebugMessenger();
 
     mSetUp.cleanup();
+    reportDebugMessages(mSetUp);
 }
 
 #pragma endregion
 
-int main()
+int main(int argc, char** argv)
 {
-    HelloTriangleApplication app;
+    AppOptions options;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--meshlets") == 0)
+            options.meshlets = true;
+        else if (strcmp(argv[i], "--bench-meshlets") == 0)
+            options.benchMeshlets = true;
+        else if (strcmp(argv[i], "--bench-scene") == 0)
+            options.benchScene = true;
+        else if (strcmp(argv[i], "--device") == 0 && i + 1 < argc)
+            options.device = argv[++i];
+        else if (strcmp(argv[i], "--list-devices") == 0)
+            options.listDevices = true;
+        else if (strcmp(argv[i], "--windows") == 0 && i + 1 < argc)
+            options.windows = static_cast<unsigned>(std::max(1, atoi(argv[++i])));
+        else if (strcmp(argv[i], "--headless") == 0 && i + 1 < argc)
+            options.headless = static_cast<unsigned>(std::max(0, atoi(argv[++i])));
+        else if (strcmp(argv[i], "--farm") == 0 && i + 1 < argc)
+            options.farmFrames = static_cast<uint32_t>(std::max(0, atoi(argv[++i])));
+        else if (strcmp(argv[i], "--farm-workers") == 0 && i + 1 < argc)
+            options.farmWorkers = static_cast<unsigned>(std::max(1, atoi(argv[++i])));
+        else if (strcmp(argv[i], "--farm-out") == 0 && i + 1 < argc)
+            options.farmOut = argv[++i];
+        else if (strcmp(argv[i], "--drs") == 0 && i + 1 < argc)
+            options.drsTargetMs = static_cast<float>(atof(argv[++i]));
+        else if (strcmp(argv[i], "--drs-min") == 0 && i + 1 < argc)
+            options.drsMinScale = std::clamp(static_cast<float>(atof(argv[++i])), 0.1f, 1.f);
+        else if (strcmp(argv[i], "--drs-log") == 0 && i + 1 < argc)
+            options.drsLog = argv[++i];
+        else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+            options.captureFile = argv[++i];
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+            options.replayFile = argv[++i];
+        else if (strcmp(argv[i], "--replay-loops") == 0 && i + 1 < argc)
+            options.replayLoops = static_cast<unsigned>(std::max(1, atoi(argv[++i])));
+        else if (strcmp(argv[i], "--compute") == 0 && i + 1 < argc)
+            options.computeMiB = static_cast<unsigned>(std::max(0, atoi(argv[++i])));
+        else if (strcmp(argv[i], "--compute-tile") == 0 && i + 1 < argc)
+            options.computeTileMiB = static_cast<unsigned>(std::max(1, atoi(argv[++i])));
+        else if (strcmp(argv[i], "--alloc-check") == 0 && i + 1 < argc)
+            options.allocCheckFrames = static_cast<uint32_t>(std::max(0, atoi(argv[++i])));
+        else if (strcmp(argv[i], "--validation") == 0 && i + 1 < argc)
+        {
+            if (!parseValidationLevel(argv[++i], options.debugFilter))
+                std::cerr << "unknown validation level " << argv[i] << ", expected off, error, warning, info or verbose" << std::endl;
+        }
+        else if (strcmp(argv[i], "--validation-types") == 0 && i + 1 < argc)
+            parseValidationTypes(argv[++i], options.debugFilter);
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+            options.traceFile = argv[++i];
+        else if (strcmp(argv[i], "--serial-init") == 0)
+            options.serialInit = true;
+        else if (strcmp(argv[i], "--msaa") == 0 && i + 1 < argc)
+            options.msaaSamples = static_cast<uint32_t>(std::max(1, atoi(argv[++i])));
+        else if (strcmp(argv[i], "--bench-msaa") == 0)
+            options.benchMsaa = true;
+        else if (strcmp(argv[i], "--features") == 0 && i + 1 < argc)
+        {
+            if (!parseFeatures<FragShader>(argv[++i], options.shaderFeatures))
+                std::cerr << "unknown shader feature in " << argv[i] << ", expected lighting and/or dither" << std::endl;
+        }
+        else if (strcmp(argv[i], "--shader-variants") == 0)
+            options.shaderVariants = true;
+        else if (strcmp(argv[i], "--soak") == 0 && i + 1 < argc)
+            options.soakFrames = std::strtoull(argv[++i], nullptr, 10);
+    }
+
+    Trace::setThreadName("main");
+    if (!options.traceFile.empty())
+        Trace::setEnabled(true);
+
+    HelloTriangleApplication app(options);
 
     try {
-        app.run();
+        if (options.listDevices)
+            runListDevices(options);
+        else if (!options.replayFile.empty())
+            runReplay(options);
+        else if (options.computeMiB > 0)
+            runComputeBatch(options);
+        else if (options.benchScene)
+            runSceneBenchmark(options);
+        else if (options.benchMsaa)
+            runMsaaBenchmark(options);
+        else if (options.shaderVariants)
+            runShaderVariants(options);
+        else if (options.soakFrames > 0)
+            runSoakTest(options);
+        else if (options.farmFrames > 0)
+            runRenderFarm(options);
+        else
+            app.run();
+
+        // Also written when the trace was only turned on with F9
+        if (!options.traceFile.empty() || Trace::eventCount() > 0)
+        {
+            std::string path = options.traceFile.empty() ? "trace.json" : options.traceFile;
+            Trace::writeChromeJson(path);
+            std::cout << "trace: " << Trace::eventCount() << " events written to " << path;
+            if (uint64_t dropped = Trace::droppedEvents())
+                std::cout << ", " << dropped << " dropped (full ring buffers)";
+            if (uint64_t discarded = Trace::discardedEvents())
+                std::cout << ", " << discarded << " oldest discarded (collected cap)";
+            std::cout << std::endl;
+        }
     }
     catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;